@@ -0,0 +1,78 @@
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Solver name -> (source, default input)
+SOLVERS = {
+    "day1": ("src/day1.c", "data/day1.txt"),
+    "day2": ("src/day2.c", "data/day2.txt"),
+    "day3": ("src/day3.c", "data/day3.txt"),
+    "day4": ("src/day4.c", "data/day4.txt"),
+    "day21": ("src/day21.cpp", "data/day21.txt"),
+    "day22": ("src/day22.cpp", "data/day22.txt"),
+    "day23": ("src/day23.cpp", "data/day23.txt"),
+    "day24p1": ("src/day24p1.cpp", "data/day24.txt"),
+}
+
+C_FLAGS = ["gcc", "-O2", "-march=native", "-pthread"]
+CXX_FLAGS = ["g++", "-O2", "-march=native", "-std=c++17", "-pthread"]
+
+
+def build_solver(name: str, build_dir: str, defines: list[str]) -> str:
+    source = os.path.join(ROOT, SOLVERS[name][0])
+    binary = os.path.join(build_dir, name)
+    compiler = CXX_FLAGS if source.endswith(".cpp") else C_FLAGS
+    flags = [f"-D{define}" for define in defines]
+    subprocess.run([*compiler, *flags, "-o", binary, source], check=True)
+    return binary
+
+
+def run_benchmark(binary: str, input_file: str, repetitions: int, warmup: int) -> dict:
+    result = subprocess.run(
+        [binary, input_file, str(repetitions), str(warmup)], check=True, capture_output=True, text=True
+    )
+    return json.loads(result.stdout)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the parse, prepare and solve phases of the C/C++ solvers")
+    parser.add_argument("solvers", nargs="*", default=list(SOLVERS), help="solvers to run (default: all)")
+    parser.add_argument("--input", help="input file instead of the default puzzle input (single solver only)")
+    parser.add_argument("--repetitions", type=int, default=100)
+    parser.add_argument("--warmup", type=int, default=5)
+    parser.add_argument("--build-dir", default=os.path.join(ROOT, "build", "bench"))
+    parser.add_argument("--define", action="append", default=[], help="extra preprocessor define for the build")
+    parser.add_argument("--output", help="JSON file to write (default: stdout)")
+    args = parser.parse_args()
+
+    if args.input and len(args.solvers) != 1:
+        parser.error("--input needs exactly one solver")
+
+    os.makedirs(args.build_dir, exist_ok=True)
+    results = []
+    for name in args.solvers:
+        if name not in SOLVERS:
+            parser.error(f"unknown solver '{name}'")
+
+        binary = build_solver(name, args.build_dir, ["AOC_BENCH", *args.define])
+        input_file = args.input or os.path.join(ROOT, SOLVERS[name][1])
+        result = run_benchmark(binary, input_file, args.repetitions, args.warmup)
+        results.append(result)
+
+        total = result["phases"]["total"]
+        print(f"{name}: median {total['median_ns'] / 1e6:.3f} ms, p99 {total['p99_ns'] / 1e6:.3f} ms", file=sys.stderr)
+
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(results, file, indent=2)
+    else:
+        json.dump(results, sys.stdout, indent=2)
+        print()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,179 @@
+import argparse
+import math
+import random
+import sys
+
+DIGIT_WORDS = ["one", "two", "three", "four", "five", "six", "seven", "eight", "nine"]
+
+
+def generate_day1(rng: random.Random, lines: int):
+    # Calibration lines mixing letters, digits and spelled out digits, every line has at least one digit
+    for _ in range(lines):
+        parts = []
+        for _ in range(rng.randint(2, 8)):
+            choice = rng.random()
+            if choice < 0.3:
+                parts.append(str(rng.randint(1, 9)))
+            elif choice < 0.5:
+                parts.append(rng.choice(DIGIT_WORDS))
+            else:
+                parts.append("".join(rng.choice("abcdefghijklmnopqrstuvwxyz") for _ in range(rng.randint(1, 6))))
+        parts.insert(rng.randint(0, len(parts)), str(rng.randint(1, 9)))
+        yield "".join(parts)
+
+
+def generate_day2(rng: random.Random, games: int):
+    for game in range(1, games + 1):
+        draws = []
+        for _ in range(rng.randint(1, 6)):
+            colors = rng.sample(["red", "green", "blue"], rng.randint(1, 3))
+            draws.append(", ".join(f"{rng.randint(1, 20)} {color}" for color in colors))
+        yield f"Game {game}: " + "; ".join(draws)
+
+
+def generate_day3(rng: random.Random, side: int):
+    # Square schematic with numbers of 1-3 digits that are separated by at least one other cell
+    for _ in range(side):
+        row = []
+        while len(row) < side:
+            choice = rng.random()
+            if choice < 0.12 and (not row or not row[-1].isdigit()):
+                row.extend(str(rng.randint(1, 999)))
+            elif choice < 0.16:
+                row.append(rng.choice("*#+$/=@%&-"))
+            else:
+                row.append(".")
+        yield "".join(row[:side])
+
+
+def generate_day4(rng: random.Random, cards: int):
+    # Same fixed column layout as the puzzle: 10 winning and 25 held numbers, right aligned in two columns.
+    # Less than one match per card on average keeps the copy counts of part 2 from exploding.
+    width = len(str(cards))
+    for card in range(1, cards + 1):
+        numbers = rng.sample(range(1, 100), 35)
+        winning, others = numbers[:10], numbers[10:]
+        matches = rng.choice([0, 0, 0, 0, 0, 1, 1, 1, 2, 4])
+        held = rng.sample(winning, matches) + others[: 25 - matches]
+        rng.shuffle(held)
+        winning_text = " ".join(f"{number:2}" for number in winning)
+        held_text = " ".join(f"{number:2}" for number in held)
+        yield f"Card {card:>{width}}: {winning_text} | {held_text}"
+
+
+def generate_day21(rng: random.Random, side: int):
+    # Odd square garden with the start in the center, the border and the center row and column stay free
+    side += 1 - side % 2
+    center = side // 2
+    for row in range(side):
+        cells = []
+        for col in range(side):
+            if row == center and col == center:
+                cells.append("S")
+            elif row in (0, center, side - 1) or col in (0, center, side - 1):
+                cells.append(".")
+            else:
+                cells.append("#" if rng.random() < 0.15 else ".")
+        yield "".join(cells)
+
+
+def generate_day22(rng: random.Random, bricks: int):
+    # Bricks get disjoint z ranges before shuffling, so no two of them overlap in the snapshot
+    width = max(10, int(math.sqrt(bricks / 15)))
+    lines = []
+    z = 1
+    for _ in range(bricks):
+        axis = rng.randrange(3)
+        length = rng.randint(1, 4 if axis == 2 else min(5, width))
+        x = rng.randrange(width - (length - 1 if axis == 0 else 0))
+        y = rng.randrange(width - (length - 1 if axis == 1 else 0))
+        end = [x, y, z]
+        end[axis] += length - 1
+        lines.append(f"{x},{y},{z}~{end[0]},{end[1]},{end[2]}")
+        z = end[2] + 1 + rng.randint(0, 2)
+    rng.shuffle(lines)
+    yield from lines
+
+
+def generate_day23(rng: random.Random, junctions: int):
+    # Lattice of k x k junctions joined by corridors with random lengths. Slopes next to the junctions
+    # only lead right and down, which keeps the slope graph of part 1 acyclic like the puzzle input.
+    k = max(2, round(math.sqrt(junctions)))
+    rows = [2]
+    cols = [1]
+    for _ in range(k - 1):
+        rows.append(rows[-1] + rng.randint(2, 24))
+        cols.append(cols[-1] + rng.randint(2, 24))
+
+    height = rows[-1] + 3
+    width = cols[-1] + 2
+    grid = [["#"] * width for _ in range(height)]
+
+    for row in range(0, rows[0]):
+        grid[row][cols[0]] = "."
+    for row in range(rows[-1], height):
+        grid[row][cols[-1]] = "."
+
+    for i, row in enumerate(rows):
+        for j, col in enumerate(cols):
+            grid[row][col] = "."
+            if j + 1 < k:
+                for c in range(col + 1, cols[j + 1]):
+                    grid[row][c] = "."
+                grid[row][col + 1] = ">"
+                grid[row][cols[j + 1] - 1] = ">"
+            if i + 1 < k:
+                for r in range(row + 1, rows[i + 1]):
+                    grid[r][col] = "."
+                grid[row + 1][col] = "v"
+                grid[rows[i + 1] - 1][col] = "v"
+
+    for row in grid:
+        yield "".join(row)
+
+
+def generate_day24(rng: random.Random, hailstones: int):
+    for _ in range(hailstones):
+        position = [rng.randint(100000000000000, 500000000000000) for _ in range(3)]
+        velocity = [rng.choice([-1, 1]) * rng.randint(1, 500) for _ in range(3)]
+        yield ", ".join(map(str, position)) + " @ " + ", ".join(map(str, velocity))
+
+
+# Solver name -> (generator, what the scale counts)
+GENERATORS = {
+    "day1": (generate_day1, "lines"),
+    "day2": (generate_day2, "games"),
+    "day3": (generate_day3, "side length"),
+    "day4": (generate_day4, "cards"),
+    "day21": (generate_day21, "side length"),
+    "day22": (generate_day22, "bricks"),
+    "day23": (generate_day23, "junctions"),
+    "day24p1": (generate_day24, "hailstones"),
+}
+
+
+def write_input(name: str, scale: int, seed: int, output):
+    generator = GENERATORS[name][0]
+    rng = random.Random(f"{name}:{seed}")
+    for line in generator(rng, scale):
+        output.write(line)
+        output.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate deterministic puzzle inputs of any size")
+    parser.add_argument("solver", choices=list(GENERATORS))
+    parser.add_argument("scale", type=int, help=", ".join(f"{name}: {unit}" for name, (_, unit) in GENERATORS.items()))
+    parser.add_argument("--seed", type=int, default=2023)
+    parser.add_argument("--output", "-o", help="file to write (default: stdout)")
+    args = parser.parse_args()
+
+    if args.output:
+        with open(args.output, "w") as file:
+            write_input(args.solver, args.scale, args.seed, file)
+    else:
+        write_input(args.solver, args.scale, args.seed, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
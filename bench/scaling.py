@@ -0,0 +1,88 @@
+import argparse
+import json
+import math
+import os
+import sys
+
+from benchmark import ROOT, build_solver, run_benchmark
+from generate import GENERATORS, write_input
+
+# Default sweep per solver, every step roughly doubles or quadruples the work of the hot loops
+DEFAULT_SIZES = {
+    "day1": [10000, 100000, 1000000],
+    "day2": [10000, 100000, 1000000],
+    "day3": [140, 1000, 3000],
+    "day4": [10000, 100000, 1000000],
+    "day21": [131, 393, 1001],
+    "day22": [1500, 3000, 6000],
+    "day23": [16, 25, 36],
+    "day24p1": [300, 1000, 3000],
+}
+
+
+def get_exponent(previous: dict, current: dict, phase: str) -> float | None:
+    # Slope in the log-log plot, 1 means linear scaling and 2 quadratic
+    size_ratio = current["scale"] / previous["scale"]
+    time_ratio = current["phases"][phase]["median_ns"] / max(previous["phases"][phase]["median_ns"], 1)
+    if size_ratio <= 1 or time_ratio <= 0:
+        return None
+    return math.log(time_ratio) / math.log(size_ratio)
+
+
+def print_curve(name: str, results: list[dict]):
+    unit = GENERATORS[name][1]
+    print(f"{name} ({unit})", file=sys.stderr)
+    for i, result in enumerate(results):
+        phases = result["phases"]
+        timings = ", ".join(f"{phase} {phases[phase]['median_ns'] / 1e6:.3f} ms" for phase in phases)
+        exponent = get_exponent(results[i - 1], result, "total") if i > 0 else None
+        slope = f", exponent {exponent:.2f}" if exponent is not None else ""
+        print(f"  {result['scale']:>10}: {timings}{slope}", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Sweep generated inputs of growing size through the solvers")
+    parser.add_argument("solvers", nargs="*", default=list(DEFAULT_SIZES), help="solvers to run (default: all)")
+    parser.add_argument("--sizes", help="comma separated scales instead of the defaults (single solver only)")
+    parser.add_argument("--seed", type=int, default=2023)
+    parser.add_argument("--repetitions", type=int, default=3)
+    parser.add_argument("--warmup", type=int, default=1)
+    parser.add_argument("--build-dir", default=os.path.join(ROOT, "build", "bench"))
+    parser.add_argument("--output", help="JSON file to write the scaling curves to")
+    args = parser.parse_args()
+
+    if args.sizes and len(args.solvers) != 1:
+        parser.error("--sizes needs exactly one solver")
+
+    input_dir = os.path.join(args.build_dir, "inputs")
+    os.makedirs(input_dir, exist_ok=True)
+
+    curves = {}
+    for name in args.solvers:
+        if name not in DEFAULT_SIZES:
+            parser.error(f"unknown solver '{name}'")
+
+        sizes = [int(size) for size in args.sizes.split(",")] if args.sizes else DEFAULT_SIZES[name]
+        binary = build_solver(name, args.build_dir, ["AOC_BENCH"])
+
+        results = []
+        for size in sizes:
+            input_file = os.path.join(input_dir, f"{name}.{size}.{args.seed}.txt")
+            if not os.path.exists(input_file):
+                with open(input_file, "w") as file:
+                    write_input(name, size, args.seed, file)
+
+            result = run_benchmark(binary, input_file, args.repetitions, args.warmup)
+            result["scale"] = size
+            results.append(result)
+
+        print_curve(name, results)
+        curves[name] = results
+
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(curves, file, indent=2)
+
+
+if __name__ == "__main__":
+    main()
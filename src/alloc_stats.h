@@ -0,0 +1,127 @@
+#ifndef ALLOC_STATS_H_
+#define ALLOC_STATS_H_
+
+// Optional heap allocation accounting per solver phase for the C++ solvers. Built with AOC_ALLOC_STATS
+// the global operator new/delete are replaced, so this header may only be included by one translation unit.
+// Otherwise (and for the C solvers) all hooks expand to nothing.
+
+#if defined(AOC_ALLOC_STATS) && defined(__cplusplus)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#define ALLOC_STATS_MAX_PHASES 8
+
+namespace alloc_stats {
+
+inline std::atomic<std::uint64_t> allocations{0};
+inline std::atomic<std::uint64_t> bytes{0};
+
+struct Session {
+    std::uint64_t begin_allocations = 0, begin_bytes = 0;
+    std::uint64_t allocations[ALLOC_STATS_MAX_PHASES] = {0};
+    std::uint64_t bytes[ALLOC_STATS_MAX_PHASES] = {0};
+    std::uint64_t runs[ALLOC_STATS_MAX_PHASES] = {0};
+};
+
+inline Session session;
+
+inline void* allocate(std::size_t size, std::size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    size = size == 0 ? 1 : size;
+    void* pointer = alignment <= alignof(std::max_align_t)
+                        ? std::malloc(size)
+                        : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+inline void phase_begin() {
+    session.begin_allocations = allocations.load();
+    session.begin_bytes = bytes.load();
+}
+
+inline void phase_end(std::size_t phase) {
+    session.allocations[phase] += allocations.load() - session.begin_allocations;
+    session.bytes[phase] += bytes.load() - session.begin_bytes;
+    ++session.runs[phase];
+}
+
+inline void reset() { session = Session(); }
+
+// Averages per run of every phase
+inline void write_json(FILE* output, const char* const* phase_names, std::size_t phase_count) {
+    std::fprintf(output, "{");
+    for (std::size_t phase = 0; phase < phase_count; ++phase) {
+        auto runs = session.runs[phase] == 0 ? 1 : session.runs[phase];
+        std::fprintf(output, "%s\"%s\": {\"allocations\": %llu, \"bytes\": %llu}", phase > 0 ? ", " : "",
+                     phase_names[phase], (unsigned long long)(session.allocations[phase] / runs),
+                     (unsigned long long)(session.bytes[phase] / runs));
+    }
+    std::fprintf(output, "}");
+}
+
+inline void report(FILE* output, const char* const* phase_names, std::size_t phase_count) {
+    for (std::size_t phase = 0; phase < phase_count; ++phase) {
+        auto runs = session.runs[phase] == 0 ? 1 : session.runs[phase];
+        std::fprintf(output, "%-8s allocations %llu bytes %llu\n", phase_names[phase],
+                     (unsigned long long)(session.allocations[phase] / runs),
+                     (unsigned long long)(session.bytes[phase] / runs));
+    }
+}
+
+}  // namespace alloc_stats
+
+void* operator new(std::size_t size) { return alloc_stats::allocate(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return alloc_stats::allocate(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return alloc_stats::allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return alloc_stats::allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return alloc_stats::allocate(size, alignof(std::max_align_t));
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+#define ALLOC_PHASE_BEGIN() alloc_stats::phase_begin()
+#define ALLOC_PHASE_END(phase) alloc_stats::phase_end(phase)
+#define ALLOC_RESET() alloc_stats::reset()
+#define ALLOC_WRITE_JSON(output, phase_names, phase_count) alloc_stats::write_json(output, phase_names, phase_count)
+#define ALLOC_REPORT(output, phase_names, phase_count) alloc_stats::report(output, phase_names, phase_count)
+
+#else
+
+#define ALLOC_PHASE_BEGIN()
+#define ALLOC_PHASE_END(phase)
+#define ALLOC_RESET()
+#define ALLOC_WRITE_JSON(output, phase_names, phase_count)
+#define ALLOC_REPORT(output, phase_names, phase_count)
+
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+#define INITIAL_ARENA_CAPACITY (64 * 1024)
+
+// Upstream of an arena, remembers how many bytes did not fit into the arena buffer
+class OverflowCounter : public std::pmr::memory_resource {
+   public:
+    std::size_t bytes = 0;
+
+   private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        this->bytes += bytes + alignment;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Monotonic scratch memory for the containers of the hot loops. reset() drops everything allocated since
+// the last reset, so only leaf functions that own all their scratch containers may call it. The buffer
+// survives the reset and grows to the largest scope seen, repeated runs therefore stop touching the heap.
+class ScratchArena {
+   public:
+    std::pmr::memory_resource* reset() {
+        resource.reset();
+        if (buffer == nullptr || overflow.bytes > 0) {
+            capacity = buffer == nullptr ? INITIAL_ARENA_CAPACITY : 2 * (capacity + overflow.bytes);
+            buffer.reset(new std::byte[capacity]);
+            overflow.bytes = 0;
+        }
+        resource.emplace(buffer.get(), capacity, &overflow);
+        return &*resource;
+    }
+
+   private:
+    std::size_t capacity = 0;
+    std::unique_ptr<std::byte[]> buffer;
+    OverflowCounter overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> resource;
+};
+
+inline ScratchArena& get_scratch_arena() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+#endif
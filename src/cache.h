@@ -0,0 +1,281 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+// Opt-in on-disk cache of solver answers, enabled by setting $AOC_CACHE_DIR.
+// An entry is keyed by a 128 bit hash of the input bytes, the input size, the solver name and the solver version, and
+// carries a checksum over its content. Entries that do not match their key or checksum are removed and recomputed.
+// A hit touches the entry. Every CACHE_EVICTION_INTERVAL-th store (on average) checks the disk usage of the directory
+// and evicts the least recently used entries down to 3/4 of $AOC_CACHE_MAX_BYTES (default DEFAULT_CACHE_MAX_BYTES).
+// Entries are written to a temporary file and renamed, so concurrent solvers never read a partial entry.
+
+#include <dirent.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "AOCC"
+#define CACHE_FORMAT_VERSION 1
+#define CACHE_SUFFIX ".aocc"
+#define CACHE_MAX_SOLVER_NAME 32
+#define CACHE_MAX_PATH 4096
+#define CACHE_MAX_FILE_NAME 96
+#define DEFAULT_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#define CACHE_EVICTION_INTERVAL 16
+
+typedef struct CacheKey {
+    const char* solver;
+    uint32_t solver_version;
+    uint64_t input_size;
+    uint64_t input_hash[2];
+} CacheKey;
+
+typedef struct CacheEntry {
+    char magic[4];
+    uint32_t format_version;
+    char solver[CACHE_MAX_SOLVER_NAME];
+    uint32_t solver_version;
+    uint32_t has_part_2;
+    uint64_t input_size;
+    uint64_t input_hash[2];
+    uint64_t part_1;
+    uint64_t part_2;
+    uint64_t checksum;  // Over all fields before it
+} CacheEntry;
+
+typedef struct CacheFile {
+    char name[CACHE_MAX_FILE_NAME];
+    time_t last_used;
+    off_t size;
+} CacheFile;
+
+static uint64_t rotate_left_u64(uint64_t value, int shift) { return (value << shift) | (value >> (64 - shift)); }
+
+static uint64_t finalize_hash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Hashes the bytes with two independently seeded lanes in a single pass over 8 byte words
+static void hash_bytes(const void* data, size_t size, uint64_t hash[2]) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t lane_1 = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t lane_2 = 0xc2b2ae3d27d4eb4fULL ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        lane_1 = rotate_left_u64(lane_1 ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+        lane_2 = rotate_left_u64(lane_2 ^ (word * 0x4cf5ad432745937fULL), 27) * 0x87c37b91114253d5ULL;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    lane_1 = finalize_hash(lane_1 ^ tail);
+    lane_2 = finalize_hash(lane_2 ^ rotate_left_u64(tail, 32));
+
+    hash[0] = lane_1;
+    hash[1] = lane_2;
+}
+
+static uint64_t get_entry_checksum(const CacheEntry* entry) {
+    uint64_t hash[2];
+    hash_bytes(entry, offsetof(CacheEntry, checksum), hash);
+    return hash[0];
+}
+
+// Returns the cache directory or NULL if caching is disabled
+static const char* get_cache_dir(void) {
+    const char* dir = getenv("AOC_CACHE_DIR");
+    return dir != NULL && *dir != '\0' ? dir : NULL;
+}
+
+static void init_cache_key(CacheKey* key, const char* solver, uint32_t solver_version, const char* input,
+                           size_t input_size) {
+    key->solver = solver;
+    key->solver_version = solver_version;
+    key->input_size = input_size;
+    hash_bytes(input, input_size, key->input_hash);
+}
+
+static int get_cache_path(char* path, const char* dir, const CacheKey* key) {
+    int length = snprintf(path, CACHE_MAX_PATH, "%s/%s-v%u-%016llx%016llx" CACHE_SUFFIX, dir, key->solver,
+                          key->solver_version, (unsigned long long)key->input_hash[0],
+                          (unsigned long long)key->input_hash[1]);
+    return length > 0 && length < CACHE_MAX_PATH && strlen(key->solver) < CACHE_MAX_SOLVER_NAME;
+}
+
+static int is_entry_of(const CacheEntry* entry, const CacheKey* key) {
+    return memcmp(entry->magic, CACHE_MAGIC, 4) == 0 && entry->format_version == CACHE_FORMAT_VERSION &&
+           strncmp(entry->solver, key->solver, CACHE_MAX_SOLVER_NAME) == 0 &&
+           entry->solver_version == key->solver_version && entry->input_size == key->input_size &&
+           entry->input_hash[0] == key->input_hash[0] && entry->input_hash[1] == key->input_hash[1] &&
+           entry->checksum == get_entry_checksum(entry);
+}
+
+// Returns 1 and fills the answers if a valid entry for the key exists
+static int lookup_cache(const CacheKey* key, uint64_t* part_1, uint64_t* part_2, int* has_part_2) {
+    const char* dir = get_cache_dir();
+    char path[CACHE_MAX_PATH];
+    if (dir == NULL || !get_cache_path(path, dir, key)) {
+        return 0;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    CacheEntry entry;
+    int is_complete = fread(&entry, sizeof(CacheEntry), 1, file) == 1 && fgetc(file) == EOF;
+    fclose(file);
+    if (!is_complete || !is_entry_of(&entry, key)) {
+        fprintf(stderr, "Removing corrupt cache entry '%s'\n", path);
+        unlink(path);
+        return 0;
+    }
+
+    utimes(path, NULL);  // Mark as recently used for the eviction
+    *part_1 = entry.part_1;
+    *part_2 = entry.part_2;
+    *has_part_2 = (int)entry.has_part_2;
+    return 1;
+}
+
+static int compare_cache_files(const void* lhs, const void* rhs) {
+    time_t a = ((const CacheFile*)lhs)->last_used;
+    time_t b = ((const CacheFile*)rhs)->last_used;
+    return (a > b) - (a < b);
+}
+
+static int has_cache_suffix(const char* name) {
+    size_t length = strlen(name);
+    size_t suffix_length = strlen(CACHE_SUFFIX);
+    return length > suffix_length && strcmp(name + length - suffix_length, CACHE_SUFFIX) == 0;
+}
+
+static uint64_t get_cache_max_bytes(void) {
+    const char* text = getenv("AOC_CACHE_MAX_BYTES");
+    if (text == NULL || *text == '\0') {
+        return DEFAULT_CACHE_MAX_BYTES;
+    }
+
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    return *end == '\0' ? (uint64_t)value : DEFAULT_CACHE_MAX_BYTES;
+}
+
+// Removes the least recently used entries if the entries of the directory use more disk space than allowed
+static void evict_cache_entries(const char* dir) {
+    DIR* directory = opendir(dir);
+    if (directory == NULL) {
+        return;
+    }
+
+    size_t count = 0, capacity = 0;
+    CacheFile* files = NULL;
+    uint64_t total_size = 0;
+
+    struct dirent* item;
+    while ((item = readdir(directory)) != NULL) {
+        if (!has_cache_suffix(item->d_name)) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            CacheFile* grown = (CacheFile*)realloc(files, capacity * sizeof(CacheFile));
+            if (grown == NULL) {
+                fprintf(stderr, "Unable to aquire memory needed to list the cache entries\n");
+                exit(EXIT_FAILURE);
+            }
+            files = grown;
+        }
+
+        CacheFile* file = &files[count];
+        char path[CACHE_MAX_PATH];
+        struct stat status;
+        int length = snprintf(path, CACHE_MAX_PATH, "%s/%s", dir, item->d_name);
+        if (strlen(item->d_name) >= CACHE_MAX_FILE_NAME || length <= 0 || length >= CACHE_MAX_PATH ||
+            stat(path, &status) != 0) {
+            continue;
+        }
+        strcpy(file->name, item->d_name);
+        file->last_used = status.st_mtime;
+        file->size = status.st_blocks * 512;
+        total_size += (uint64_t)file->size;
+        ++count;
+    }
+    closedir(directory);
+
+    uint64_t max_bytes = get_cache_max_bytes();
+    if (total_size > max_bytes) {
+        qsort(files, count, sizeof(CacheFile), compare_cache_files);
+        for (size_t i = 0; i < count && total_size > max_bytes / 4 * 3; ++i) {
+            char path[CACHE_MAX_PATH];
+            snprintf(path, CACHE_MAX_PATH, "%s/%s", dir, files[i].name);
+            if (unlink(path) == 0) {
+                total_size -= (uint64_t)files[i].size;
+            }
+        }
+    }
+
+    free(files);
+}
+
+// Stores the answers for the key, failures to write only cost the next lookup
+static void store_cache(const CacheKey* key, uint64_t part_1, uint64_t part_2, int has_part_2) {
+    const char* dir = get_cache_dir();
+    char path[CACHE_MAX_PATH];
+    char temporary_path[CACHE_MAX_PATH];
+    if (dir == NULL || !get_cache_path(path, dir, key) ||
+        snprintf(temporary_path, CACHE_MAX_PATH, "%s/.entry-XXXXXX", dir) >= CACHE_MAX_PATH) {
+        return;
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Unable to create the cache directory '%s'\n", dir);
+        return;
+    }
+
+    CacheEntry entry;
+    memset(&entry, 0, sizeof(CacheEntry));
+    memcpy(entry.magic, CACHE_MAGIC, 4);
+    entry.format_version = CACHE_FORMAT_VERSION;
+    strncpy(entry.solver, key->solver, CACHE_MAX_SOLVER_NAME - 1);
+    entry.solver_version = key->solver_version;
+    entry.has_part_2 = (uint32_t)has_part_2;
+    entry.input_size = key->input_size;
+    entry.input_hash[0] = key->input_hash[0];
+    entry.input_hash[1] = key->input_hash[1];
+    entry.part_1 = part_1;
+    entry.part_2 = part_2;
+    entry.checksum = get_entry_checksum(&entry);
+
+    int fd = mkstemp(temporary_path);
+    if (fd < 0) {
+        return;
+    }
+    int is_written = write(fd, &entry, sizeof(CacheEntry)) == (ssize_t)sizeof(CacheEntry);
+    close(fd);
+    if (!is_written || rename(temporary_path, path) != 0) {
+        unlink(temporary_path);
+        return;
+    }
+
+    if (key->input_hash[0] % CACHE_EVICTION_INTERVAL == 0) {
+        evict_cache_entries(dir);
+    }
+}
+
+#endif
@@ -4,18 +4,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static FILE* open_input_file_or_panic(int argc, const char const**argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Invalid usage\n%s <DATA FILENAME>\n", argv[0]);
+static FILE* open_file_or_panic(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Invalid filename '%s'\n", filename);
         exit(EXIT_FAILURE);
     }
+    return file;
+}
 
-    FILE* file = fopen(argv[1], "r");
-    if (file == NULL) {
-        fprintf(stderr, "Invalid filename '%s'\n", argv[1]);
+static inline FILE* open_input_file_or_panic(int argc, const char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Invalid usage\n%s <DATA FILENAME>\n", argv[0]);
         exit(EXIT_FAILURE);
     }
-    return file;
+
+    return open_file_or_panic(argv[1]);
 }
 
 static char* read_content(FILE* file, size_t* size) {
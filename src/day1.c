@@ -5,19 +5,30 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "common.h"
+#include "solver.h"
 
-const char const* DIGIT_LITERALS[] = {"zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
+const char* const DIGIT_LITERALS[] = {"zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
 const size_t DIGIT_LITERALS_LENGTH[] = {4, 3, 3, 5, 4, 4, 3, 5, 5, 4};
 
 int find_first_last_digit(const char* str, int32_t* first, int32_t* last, int allow_literals);
 int32_t eval_calibration_value(int32_t first, int32_t last);
 int try_parse_digit(const char* str, int32_t* value, int allow_literals);
+void* solver_parse(const char* input, size_t input_size);
+int solver_solve(void* state, SolverAnswers* answers);
+void solver_release(void* state);
+
+// The calibration document is evaluated directly on the text, parsing only keeps track of the buffer
+typedef struct Document {
+    const char* content;
+    size_t size;
+} Document;
+
+const Solver DAY1_SOLVER = {"day1", 1, solver_parse, NULL, solver_solve, solver_release};
 
 int find_first_last_digit(const char* str, int32_t* first, int32_t* last, int allow_literals) {
     int no_digit_yet_found = -1;
 
-    for (size_t i = 0; str[i] != '\0'; ++i) {
+    for (size_t i = 0; str[i] != '\0' && str[i] != '\n'; ++i) {
         int32_t current_digit;
         if (!try_parse_digit(&str[i], &current_digit, allow_literals)) {
             continue;
@@ -54,37 +65,46 @@ int try_parse_digit(const char* str, int32_t* value, int allow_literals) {
     return 0;
 }
 
-int main(int argc, const char** argv) {
-    FILE* file = open_input_file_or_panic(argc, argv);
+void* solver_parse(const char* input, size_t input_size) {
+    Document* document = (Document*)malloc(sizeof(Document));
+    document->content = input;
+    document->size = input_size;
+    return document;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    const Document* document = (const Document*)state;
 
     int32_t result_1 = 0;
     int32_t result_2 = 0;
 
-    size_t line_buffer_len = 0;
-    char* line = NULL;
-    ssize_t chars_read;
-    for (size_t line_index = 0; (chars_read = getline(&line, &line_buffer_len, file)) != -1; ++line_index) {
-        int32_t first, last;
+    size_t line_start = 0;
+    for (size_t line_index = 0; line_start < document->size; ++line_index) {
+        const char* line = &document->content[line_start];
+
+        int32_t first = 0, last = 0;
         if (find_first_last_digit(line, &first, &last, 0)) {
-            fprintf(stderr, "No digits found in line %d\n", line_index + 1);
-            exit(EXIT_FAILURE);
+            fprintf(stderr, "No digits found in line %zu\n", line_index + 1);
+            return 0;
         }
         result_1 += eval_calibration_value(first, last);
 
         if (find_first_last_digit(line, &first, &last, 1)) {
-            fprintf(stderr, "No digits or literals found in line %d\n", line_index + 1);
-            exit(EXIT_FAILURE);
+            fprintf(stderr, "No digits or literals found in line %zu\n", line_index + 1);
+            return 0;
         }
         result_2 += eval_calibration_value(first, last);
-    }
 
-    if (line != NULL) {
-        free(line);
+        const char* line_end = strchr(line, '\n');
+        line_start = line_end == NULL ? document->size : (size_t)(line_end - document->content) + 1;
     }
-    fclose(file);
-
-    printf("Part 1: %d\n", result_1);
-    printf("Part 2: %d\n", result_2);
 
-    exit(EXIT_SUCCESS);
+    answers->part_1 = result_1;
+    answers->part_2 = result_2;
+    answers->has_part_2 = 1;
+    return 1;
 }
+
+void solver_release(void* state) { free(state); }
+
+int main(int argc, const char** argv) { return solver_main(argc, argv, &DAY1_SOLVER); }
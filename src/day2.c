@@ -3,28 +3,83 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "common.h"
+#include "server.h"
+#include "solver.h"
 
 #define NUMBER_RED_CUBES 12
 #define NUMBER_GREEN_CUBES 13
 #define NUMBER_BLUE_CUBES 14
 
-int32_t parse_game_id(const char* line, size_t* index);
+#define INITIAL_GAME_TABLE_CAPACITY 128
+#define MAX_DOMINANCE_INDEX_CELLS (1 << 22)
+
+// Structure of arrays holding the minimal cube set of every game, so limit queries scan plain columns.
+typedef struct GameTable {
+    size_t size;
+    size_t capacity;
+    int32_t* ids;
+    int32_t* red;
+    int32_t* green;
+    int32_t* blue;
+} GameTable;
+
+// Summed id of all games whose minimal set fits into the limits, indexed by [red][green][blue] limit.
+typedef struct DominanceIndex {
+    size_t red_size;
+    size_t green_size;
+    size_t blue_size;
+    int64_t* id_sums;
+} DominanceIndex;
+
+// Games with the dominance index if the limits are dense enough for one, answers any number of limit queries.
+typedef struct LimitQueries {
+    const GameTable* table;
+    DominanceIndex index;
+    int has_index;
+} LimitQueries;
+
+int parse_game_id(const char* line, size_t* index, int32_t* id);
 int are_draws_left(const char* line, size_t index);
-void get_draw_amounts(const char* line, size_t* index, int32_t* red, int32_t* green, int32_t* blue);
+int get_draw_amounts(const char* line, size_t* index, int32_t* red, int32_t* green, int32_t* blue);
 int32_t max(int32_t value1, int32_t value2);
 int is_valid_draw(int32_t red, int32_t green, int32_t blue);
 int32_t eval_set_power(int32_t red, int32_t green, int32_t blue);
+int get_minimum_set(const char* line, size_t index, int32_t* red, int32_t* green, int32_t* blue);
+void push_game(GameTable* table, int32_t id, int32_t red, int32_t green, int32_t blue);
+int parse_game_table(const char* input, size_t input_size, GameTable* table);
+void free_game_table(GameTable* table);
+int64_t sum_valid_game_ids(const GameTable* table, int32_t red, int32_t green, int32_t blue);
+int build_dominance_index(const GameTable* table, DominanceIndex* index);
+size_t clamp_limit(int32_t limit, size_t size);
+int64_t query_dominance_index(const DominanceIndex* index, int32_t red, int32_t green, int32_t blue);
+void init_limit_queries(LimitQueries* queries, const GameTable* table);
+int64_t answer_limit_query(const LimitQueries* queries, int32_t red, int32_t green, int32_t blue);
+void free_limit_queries(LimitQueries* queries);
+void answer_limit_queries(const GameTable* table, FILE* queries);
+int handle_limit_query(void* state, const char* query, char* reply, size_t reply_size);
+void* solver_parse(const char* input, size_t input_size);
+int solver_solve(void* state, SolverAnswers* answers);
+void solver_release(void* state);
+
+const Solver DAY2_SOLVER = {"day2", 1, solver_parse, NULL, solver_solve, solver_release};
 
-int32_t parse_game_id(const char* line, size_t* index) {
+int parse_game_id(const char* line, size_t* index, int32_t* id) {
+    if (strncmp(line, "Game ", 5) != 0) {
+        return 0;
+    }
     for (*index = 5; line[*index] != ':'; ++(*index)) {
+        if (line[*index] == '\0' || line[*index] == '\n') {
+            return 0;
+        }
     }
-    return atoi(&line[5]);
+    *id = atoi(&line[5]);
+    return 1;
 }
 
 int are_draws_left(const char* line, size_t index) {
-    for (; line[index] != '\0'; ++index) {
+    for (; line[index] != '\0' && line[index] != '\n'; ++index) {
         if (isdigit(line[index])) {
             return 1;
         }
@@ -32,18 +87,22 @@ int are_draws_left(const char* line, size_t index) {
     return 0;
 }
 
-void get_draw_amounts(const char* line, size_t* index, int32_t* red, int32_t* green, int32_t* blue) {
+int get_draw_amounts(const char* line, size_t* index, int32_t* red, int32_t* green, int32_t* blue) {
     *red = 0;
     *green = 0;
     *blue = 0;
 
     ++(*index);  // Move away from draw delimiter
     while (line[*index] != ';' && line[*index] != '\n' && line[*index] != '\0') {
-        while (!isdigit(line[++(*index)])) {
+        while (line[++(*index)] != '\0' && !isdigit(line[*index])) {
         }  // advance to next digit
+        if (line[*index] == '\0') {
+            fprintf(stderr, "Missing cube amount\n");
+            return 0;
+        }
         int32_t amount = atoi(&line[*index]);
 
-        while (!islower(line[++(*index)])) {
+        while (line[++(*index)] != '\0' && !islower(line[*index])) {
         }  // advance to color specifier
         char color = line[*index];
 
@@ -59,12 +118,13 @@ void get_draw_amounts(const char* line, size_t* index, int32_t* red, int32_t* gr
                 break;
             default:
                 fprintf(stderr, "Unknown color character %c\n", color);
-                exit(EXIT_FAILURE);
+                return 0;
         }
 
         while (islower(line[++(*index)])) {
         }  // advance to the delimiter
     }
+    return 1;
 }
 
 int32_t max(int32_t value1, int32_t value2) { return value1 > value2 ? value1 : value2; }
@@ -75,46 +135,256 @@ int is_valid_draw(int32_t red, int32_t green, int32_t blue) {
 
 int32_t eval_set_power(int32_t red, int32_t green, int32_t blue) { return red * green * blue; }
 
-int main(int argc, const char** argv) {
-    FILE* file = open_input_file_or_panic(argc, argv);
+int get_minimum_set(const char* line, size_t index, int32_t* red, int32_t* green, int32_t* blue) {
+    *red = 0;
+    *green = 0;
+    *blue = 0;
 
-    int32_t result_1 = 0;
-    int32_t result_2 = 0;
+    while (are_draws_left(line, index)) {
+        int32_t current_red, current_green, current_blue;
+        if (!get_draw_amounts(line, &index, &current_red, &current_green, &current_blue)) {
+            return 0;
+        }
+
+        *red = max(*red, current_red);
+        *green = max(*green, current_green);
+        *blue = max(*blue, current_blue);
+    }
+    return 1;
+}
+
+void push_game(GameTable* table, int32_t id, int32_t red, int32_t green, int32_t blue) {
+    if (table->size == table->capacity) {
+        table->capacity = table->capacity == 0 ? INITIAL_GAME_TABLE_CAPACITY : table->capacity * 2;
+        table->ids = (int32_t*)realloc(table->ids, table->capacity * sizeof(int32_t));
+        table->red = (int32_t*)realloc(table->red, table->capacity * sizeof(int32_t));
+        table->green = (int32_t*)realloc(table->green, table->capacity * sizeof(int32_t));
+        table->blue = (int32_t*)realloc(table->blue, table->capacity * sizeof(int32_t));
+        if (table->ids == NULL || table->red == NULL || table->green == NULL || table->blue == NULL) {
+            fprintf(stderr, "Unable to aquire memory needed to store %zu games\n", table->capacity);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    size_t line_buffer_len = 0;
-    char* line = NULL;
-    ssize_t chars_read;
-    while ((chars_read = getline(&line, &line_buffer_len, file)) != -1) {
+    table->ids[table->size] = id;
+    table->red[table->size] = red;
+    table->green[table->size] = green;
+    table->blue[table->size] = blue;
+    ++table->size;
+}
+
+// Returns 0 for a malformed game, the table is empty then
+int parse_game_table(const char* input, size_t input_size, GameTable* table) {
+    *table = (GameTable){0};
+
+    size_t line_start = 0;
+    for (size_t line_index = 0; line_start < input_size; ++line_index) {
+        const char* line = &input[line_start];
         size_t index = 0;
-        int32_t id = parse_game_id(line, &index);
+        int32_t id, red, green, blue;
+        if (!parse_game_id(line, &index, &id) || !get_minimum_set(line, index, &red, &green, &blue)) {
+            fprintf(stderr, "Malformed game in line %zu\n", line_index + 1);
+            free_game_table(table);
+            return 0;
+        }
+        push_game(table, id, red, green, blue);
+
+        const char* line_end = strchr(line, '\n');
+        line_start = line_end == NULL ? input_size : (size_t)(line_end - input) + 1;
+    }
+
+    return 1;
+}
+
+void free_game_table(GameTable* table) {
+    free(table->ids);
+    free(table->red);
+    free(table->green);
+    free(table->blue);
+    *table = (GameTable){0};
+}
 
-        int32_t min_red = 0;
-        int32_t min_green = 0;
-        int32_t min_blue = 0;
+int64_t sum_valid_game_ids(const GameTable* table, int32_t red, int32_t green, int32_t blue) {
+    // Branchless on purpose, so the compiler can vectorize the scan over the columns
+    int64_t result = 0;
+    for (size_t i = 0; i < table->size; ++i) {
+        int32_t is_valid = (table->red[i] <= red) & (table->green[i] <= green) & (table->blue[i] <= blue);
+        result += table->ids[i] & -is_valid;
+    }
+    return result;
+}
+
+int build_dominance_index(const GameTable* table, DominanceIndex* index) {
+    int32_t max_red = 0, max_green = 0, max_blue = 0;
+    for (size_t i = 0; i < table->size; ++i) {
+        max_red = max(max_red, table->red[i]);
+        max_green = max(max_green, table->green[i]);
+        max_blue = max(max_blue, table->blue[i]);
+    }
+
+    index->red_size = (size_t)max_red + 1;
+    index->green_size = (size_t)max_green + 1;
+    index->blue_size = (size_t)max_blue + 1;
 
-        while (are_draws_left(line, index)) {
-            int32_t current_red, current_green, current_blue;
-            get_draw_amounts(line, &index, &current_red, &current_green, &current_blue);
+    size_t plane_size = index->green_size * index->blue_size;
+    if (plane_size > MAX_DOMINANCE_INDEX_CELLS / index->red_size) {
+        return 0;  // Too sparse for a dense index, queries have to scan the table
+    }
+
+    index->id_sums = (int64_t*)calloc(index->red_size * plane_size, sizeof(int64_t));
+    if (index->id_sums == NULL) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < table->size; ++i) {
+        index->id_sums[table->red[i] * plane_size + table->green[i] * index->blue_size + table->blue[i]] +=
+            table->ids[i];
+    }
 
-            min_red = max(min_red, current_red);
-            min_green = max(min_green, current_green);
-            min_blue = max(min_blue, current_blue);
+    // Prefix sums along every axis turn the histogram into "all games dominated by the limit"
+    for (size_t r = 0; r < index->red_size; ++r) {
+        for (size_t g = 0; g < index->green_size; ++g) {
+            int64_t* row = &index->id_sums[r * plane_size + g * index->blue_size];
+            for (size_t b = 1; b < index->blue_size; ++b) {
+                row[b] += row[b - 1];
+            }
+            if (g > 0) {
+                for (size_t b = 0; b < index->blue_size; ++b) {
+                    row[b] += row[b - index->blue_size];
+                }
+            }
         }
+        if (r > 0) {
+            int64_t* plane = &index->id_sums[r * plane_size];
+            for (size_t i = 0; i < plane_size; ++i) {
+                plane[i] += plane[i - plane_size];
+            }
+        }
+    }
+    return 1;
+}
+
+size_t clamp_limit(int32_t limit, size_t size) { return (size_t)limit < size ? (size_t)limit : size - 1; }
+
+int64_t query_dominance_index(const DominanceIndex* index, int32_t red, int32_t green, int32_t blue) {
+    if (red < 0 || green < 0 || blue < 0) {
+        return 0;
+    }
+
+    size_t r = clamp_limit(red, index->red_size);
+    size_t g = clamp_limit(green, index->green_size);
+    size_t b = clamp_limit(blue, index->blue_size);
+    return index->id_sums[(r * index->green_size + g) * index->blue_size + b];
+}
+
+void init_limit_queries(LimitQueries* queries, const GameTable* table) {
+    queries->table = table;
+    queries->index = (DominanceIndex){0};
+    queries->has_index = build_dominance_index(table, &queries->index);
+}
+
+int64_t answer_limit_query(const LimitQueries* queries, int32_t red, int32_t green, int32_t blue) {
+    return queries->has_index ? query_dominance_index(&queries->index, red, green, blue)
+                              : sum_valid_game_ids(queries->table, red, green, blue);
+}
+
+void free_limit_queries(LimitQueries* queries) {
+    free(queries->index.id_sums);
+    queries->index.id_sums = NULL;
+}
+
+void answer_limit_queries(const GameTable* table, FILE* queries) {
+    LimitQueries limits;
+    init_limit_queries(&limits, table);
+
+    int32_t red, green, blue;
+    while (fscanf(queries, "%d %d %d", &red, &green, &blue) == 3) {
+        printf("%d %d %d: %lld\n", red, green, blue, (long long)answer_limit_query(&limits, red, green, blue));
+    }
+
+    free_limit_queries(&limits);
+}
+
+// Server query "<RED> <GREEN> <BLUE>", replies with the summed id of the games possible with these cubes
+int handle_limit_query(void* state, const char* query, char* reply, size_t reply_size) {
+    int32_t red, green, blue;
+    int length = 0;
+    if (sscanf(query, "%d %d %d%n", &red, &green, &blue, &length) != 3 || query[length] != '\0') {
+        return 0;
+    }
 
-        if (is_valid_draw(min_red, min_green, min_blue)) {
-            result_1 += id;
+    snprintf(reply, reply_size, "%lld", (long long)answer_limit_query((const LimitQueries*)state, red, green, blue));
+    return 1;
+}
+
+void* solver_parse(const char* input, size_t input_size) {
+    GameTable* table = (GameTable*)malloc(sizeof(GameTable));
+    if (!parse_game_table(input, input_size, table)) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    const GameTable* table = (const GameTable*)state;
+
+    int32_t result_1 = 0;
+    int32_t result_2 = 0;
+    for (size_t i = 0; i < table->size; ++i) {
+        if (is_valid_draw(table->red[i], table->green[i], table->blue[i])) {
+            result_1 += table->ids[i];
         }
 
-        result_2 += eval_set_power(min_red, min_green, min_blue);
+        result_2 += eval_set_power(table->red[i], table->green[i], table->blue[i]);
     }
 
-    if (line != NULL) {
-        free(line);
+    answers->part_1 = result_1;
+    answers->part_2 = result_2;
+    answers->has_part_2 = 1;
+    return 1;
+}
+
+void solver_release(void* state) {
+    free_game_table((GameTable*)state);
+    free(state);
+}
+
+int main(int argc, const char** argv) {
+    if (argc == 4 && strcmp(argv[1], SERVE_FLAG) == 0) {  // Answer limit queries on a socket, the games stay resident
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        GameTable table;
+        if (!parse_game_table(input, input_size, &table)) {
+            exit(EXIT_FAILURE);
+        }
+        LimitQueries limits;
+        init_limit_queries(&limits, &table);
+
+        serve_queries(argv[3], handle_limit_query, &limits);
+
+        free_limit_queries(&limits);
+        free_game_table(&table);
+        free(input);
+        exit(EXIT_SUCCESS);
     }
-    fclose(file);
 
-    printf("Part 1: %d\n", result_1);
-    printf("Part 2: %d\n", result_2);
+    if (argc == 4 && strcmp(argv[1], "--queries") == 0) {  // Evaluate every bag configuration of the query file
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        FILE* queries = open_file_or_panic(argv[3]);
+
+        GameTable table;
+        if (!parse_game_table(input, input_size, &table)) {
+            exit(EXIT_FAILURE);
+        }
+        answer_limit_queries(&table, queries);
+
+        free_game_table(&table);
+        fclose(queries);
+        free(input);
+        exit(EXIT_SUCCESS);
+    }
 
-    exit(EXIT_SUCCESS);
+    return solver_main(argc, argv, &DAY2_SOLVER);
 }
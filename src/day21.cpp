@@ -1,14 +1,24 @@
+#include <algorithm>
 #include <cassert>
-#include <deque>
-#include <fstream>
-#include <iostream>
-#include <unordered_set>
+#include <cstdint>
+#include <cstdio>
+#include <string>
 #include <vector>
 
-int DR[] = {1, -1, 0, 0};
-int DC[] = {0, 0, 1, -1};
+#include "arena.hpp"
+#include "grid.hpp"
+#include "parallel.hpp"
+#include "server.h"
+#include "solver.h"
+#include "trace.hpp"
 
-using Map = std::vector<std::string>;
+#define PART_2_STEPS 26501365
+#define PART_2_MAP_REPETITIONS 202300
+#define LANE_WORDS 4
+#define MULTI_SOURCE_LANES (64 * LANE_WORDS)
+#define COUNTER_PLANES 48
+
+using Map = PaddedGrid;
 
 struct Position {
     int row, col;
@@ -16,106 +26,424 @@ struct Position {
     bool operator==(const Position& pos) const { return this->row == pos.row && this->col == pos.col; }
 };
 
-class PositionHash {
-   public:
-    std::size_t operator()(const Position& pos) const { return pos.row * 10000 + pos.col; }
-};
-
-using PositionSet = std::unordered_set<Position, PositionHash>;
-
-struct PositionState {
-    Position pos;
+struct FieldState {
+    std::size_t index;
     std::size_t steps;
-    PositionState(int row, int col, std::size_t steps) : pos(row, col), steps(steps) {}
+    FieldState(std::size_t index, std::size_t steps) : index(index), steps(steps) {}
 };
 
-Map read_map(const char* filename) {
+struct Garden {
     Map map;
+    Position start = Position(0, 0);
+};
 
-    std::ifstream file(filename);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            map.push_back(line);
+bool find_start(const Map& map, Position& start) {
+    for (int row = 0; row < map.rows; ++row) {
+        for (auto col = 0; col < map.cols; ++col) {
+            if (map[map.index(row, col)] == 'S') {
+                start = Position(row, col);
+                return true;
+            }
         }
-        file.close();
     }
+    return false;
+}
 
-    return map;
+// The repeated maps are only counted correctly on square maps with the start in the center, the step budget
+// has to end on a map edge
+bool has_input_properties(const Map& map, const Position& pos, std::size_t steps) {
+    auto rows = map.rows;
+    auto cols = map.cols;
+
+    return rows == cols && pos.row == rows / 2 && pos.col == cols / 2 &&
+           steps % rows == static_cast<std::size_t>(rows / 2);
 }
 
-Position find_start(const Map& map) {
-    for (int row = 0; row < map.size(); ++row) {
-        for (auto col = 0; col < map[row].length(); ++col) {
-            if (map[row][col] == 'S') {
-                return Position(row, col);
+std::size_t count_fields(const Map& map, int row, int col, int steps) {
+    TRACE_SCOPE("count_fields");
+    auto memory = get_scratch_arena().reset();
+    // Rock and the border count as seen, so the BFS only has to look at one byte per neighbour
+    std::pmr::vector<char> seen(map.cells.size(), 0, memory);
+    for (std::size_t i = 0; i < map.cells.size(); ++i) {
+        seen[i] = map[i] == '#';
+    }
+
+    // Every field is queued at most once, so a vector with a read index is enough for the BFS queue
+    std::pmr::vector<FieldState> queue(memory);
+    queue.reserve(map.rows * map.cols);
+    std::size_t queue_head = 0;
+    std::size_t answer = 0;
+
+    auto start = map.index(row, col);
+    seen[start] = 1;
+    queue.push_back(FieldState(start, steps));
+
+    while (queue_head < queue.size()) {
+        auto current = queue[queue_head++];
+        TRACE_ADD("expansions", 1);
+
+        answer += current.steps % 2 == 0;
+
+        if (current.steps == 0) {
+            continue;
+        }
+
+        for (int direction = 0; direction < GRID_NEIGHBOURS; ++direction) {
+            auto next = map.neighbour(current.index, direction);
+            if (seen[next]) {
+                continue;
             }
+
+            seen[next] = 1;
+            queue.push_back(FieldState(next, current.steps - 1));
         }
+        TRACE_MAX("max_queue", queue.size() - queue_head);
     }
-    assert(false);
+
+    TRACE_ADD("visited", queue.size());
+    TRACE_ADD("reachable", answer);
+    return answer;
 }
 
-void assert_input_properties(const Map& map, const Position& pos, std::size_t steps) {
-    auto rows = map.size();
-    auto cols = map[0].length();
+// fields_by_steps[k] is count_fields(map, row, col, k) for every k up to the largest distance plus one, larger step
+// budgets reach nothing new and repeat the entry of their parity.
+std::vector<std::size_t> count_fields_by_steps(const Map& map, int row, int col) {
+    auto memory = get_scratch_arena().reset();
+    std::pmr::vector<char> seen(map.cells.size(), 0, memory);
+    for (std::size_t i = 0; i < map.cells.size(); ++i) {
+        seen[i] = map[i] == '#';
+    }
+
+    // Same BFS as count_fields, but the states carry the distance from the start
+    std::pmr::vector<FieldState> queue(memory);
+    queue.reserve(map.rows * map.cols);
+    std::size_t queue_head = 0;
+    std::vector<std::size_t> fields_by_steps;
+
+    auto start = map.index(row, col);
+    seen[start] = 1;
+    queue.push_back(FieldState(start, 0));
+    while (queue_head < queue.size()) {
+        auto current = queue[queue_head++];
+        if (current.steps >= fields_by_steps.size()) {
+            fields_by_steps.push_back(0);
+        }
+        ++fields_by_steps[current.steps];
 
-    assert(rows == cols);
-    assert(pos.row == rows / 2);
-    assert(pos.col == cols / 2);
+        for (int direction = 0; direction < GRID_NEIGHBOURS; ++direction) {
+            auto next = map.neighbour(current.index, direction);
+            if (!seen[next]) {
+                seen[next] = 1;
+                queue.push_back(FieldState(next, current.steps + 1));
+            }
+        }
+    }
 
-    assert(steps % rows == rows / 2);
+    // A field at distance d is counted for every budget of the same parity from d on
+    fields_by_steps.push_back(0);
+    for (std::size_t steps = 2; steps < fields_by_steps.size(); ++steps) {
+        fields_by_steps[steps] += fields_by_steps[steps - 2];
+    }
+    return fields_by_steps;
 }
-bool is_valid_pos(const Map& map, const Position& pos) {
-    return 0 <= pos.row && pos.row < map.size() && 0 <= pos.col && pos.col < map[pos.row].length() &&
-           map[pos.row][pos.col] != '#';
+
+// Fields reachable within a step budget, split by the parity of their distance from the start.
+// count_fields(map, row, col, steps) is even for an even budget and odd for an odd one.
+struct ReachableCounts {
+    std::size_t even = 0, odd = 0;
+};
+
+// One bit per start of a sweep. The GCC vector extension makes every operation on a block cover all starts at once,
+// as AVX2 instructions where available and as SSE2 or scalar word pairs elsewhere.
+typedef std::uint64_t LaneBlock __attribute__((vector_size(8 * LANE_WORDS)));
+
+bool is_empty(const LaneBlock& lanes) {
+    std::uint64_t any = 0;
+    for (int word = 0; word < LANE_WORDS; ++word) {
+        any |= lanes[word];
+    }
+    return any == 0;
 }
 
-std::size_t count_fields(const Map& map, int row, int col, int steps) {
-    std::deque<PositionState> queue;
-    PositionSet seen;
-    PositionSet answer;
-    ;
-    queue.push_back(PositionState(row, col, steps));
+void set_lane_bit(LaneBlock& block, std::size_t lane) { block[lane / 64] |= std::uint64_t(1) << (lane % 64); }
 
-    while (queue.size() > 0) {
-        auto current = queue.front();
-        queue.pop_front();
+// The blocks go by reference, passing vector types by value depends on the enabled instruction sets.
+// low may be the same block as a, so it is written last.
+void carry_save_add(LaneBlock& high, LaneBlock& low, const LaneBlock& a, const LaneBlock& b, const LaneBlock& c) {
+    auto partial = a ^ b;
+    auto sum = partial ^ c;
+    high = (a & b) | (partial & c);
+    low = sum;
+}
 
-        if (current.steps % 2 == 0) {
-            answer.insert(current.pos);
+// One counter per lane kept bit-sliced, so adding a block costs a few vector operations instead of one increment per
+// set bit. Eight blocks at a time go through a carry-save adder tree (Harley-Seal) into the planes of weight 1, 2 and
+// 4, only its weight 8 output ripples into the upper planes.
+struct LaneCounters {
+    LaneBlock ones = {}, twos = {}, fours = {};
+    LaneBlock eights[COUNTER_PLANES] = {};  // Plane b holds bit b of the number of eights of every lane
+
+    void add_eights(const LaneBlock& carry) {
+        auto lanes = carry;
+        for (int plane = 0; !is_empty(lanes); ++plane) {
+            auto carry = eights[plane] & lanes;
+            eights[plane] ^= lanes;
+            lanes = carry;
         }
+    }
 
-        if (current.steps == 0) {
-            continue;
+    void add(const LaneBlock& lanes) {
+        auto carry = ones & lanes;
+        ones ^= lanes;
+        auto carry_2 = twos & carry;
+        twos ^= carry;
+        carry = fours & carry_2;
+        fours ^= carry_2;
+        add_eights(carry);
+    }
+
+    void add_all(const LaneBlock* blocks, std::size_t count) {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const auto* b = blocks + i;
+            if (is_empty(b[0] | b[1] | b[2] | b[3] | b[4] | b[5] | b[6] | b[7])) {
+                continue;  // Most of the grid is outside of the frontiers
+            }
+            LaneBlock twos_a, twos_b, fours_a, fours_b, eights_out;
+            carry_save_add(twos_a, ones, ones, b[0], b[1]);
+            carry_save_add(twos_b, ones, ones, b[2], b[3]);
+            carry_save_add(fours_a, twos, twos, twos_a, twos_b);
+            carry_save_add(twos_a, ones, ones, b[4], b[5]);
+            carry_save_add(twos_b, ones, ones, b[6], b[7]);
+            carry_save_add(fours_b, twos, twos, twos_a, twos_b);
+            carry_save_add(eights_out, fours, fours, fours_a, fours_b);
+            add_eights(eights_out);
+        }
+        for (; i < count; ++i) {
+            add(blocks[i]);
         }
+    }
 
-        for (int iDelta = 0; iDelta < 4; ++iDelta) {
-            int row = current.pos.row + DR[iDelta];
-            int col = current.pos.col + DC[iDelta];
-            Position pos(row, col);
+    std::size_t get(std::size_t lane) const {
+        auto word = lane / 64;
+        auto shift = lane % 64;
+        std::size_t count = 0;
+        for (int plane = 0; plane < COUNTER_PLANES; ++plane) {
+            count |= static_cast<std::size_t>((eights[plane][word] >> shift) & 1) << plane;
+        }
+        return count * 8 + ((fours[word] >> shift) & 1) * 4 + ((twos[word] >> shift) & 1) * 2 +
+               ((ones[word] >> shift) & 1);
+    }
+};
 
-            if (!is_valid_pos(map, pos) || seen.count(pos)) {
+// Runs the BFS of up to MULTI_SOURCE_LANES starts at once, lane i of a cell block belongs to starts[i].
+// A step ORs the frontier blocks of the four neighbours of every field, so all starts advance with one branch-free
+// pass over the grid. Rows without a frontier next to them are skipped. The fields first reached in step d are at
+// distance d from their start, so the new blocks are simply counted per parity of the step.
+void count_fields_in_lanes(const Map& map, const Position* starts, std::size_t start_count,
+                           const std::vector<std::size_t>& budgets, ReachableCounts* counts) {
+    TRACE_SCOPE("count_fields_in_lanes");
+    auto memory = get_scratch_arena().reset();
+    // Rock and the border count as reached by every start
+    std::pmr::vector<LaneBlock> reached(map.cells.size(), LaneBlock{}, memory);
+    std::pmr::vector<LaneBlock> frontier(map.cells.size(), LaneBlock{}, memory);
+    std::pmr::vector<LaneBlock> next_frontier(map.cells.size(), LaneBlock{}, memory);
+    for (std::size_t i = 0; i < map.cells.size(); ++i) {
+        if (map[i] == '#') {
+            reached[i] = ~LaneBlock{};
+        }
+    }
+    // Whether a row of the frontiers has any bit set, with an empty row above and below the map
+    std::pmr::vector<char> is_frontier_row(map.rows + 2, 0, memory);
+    std::pmr::vector<char> is_next_frontier_row(map.rows + 2, 0, memory);
+
+    LaneCounters parity_counts[2];
+    for (std::size_t lane = 0; lane < start_count; ++lane) {
+        auto start = map.index(starts[lane].row, starts[lane].col);
+        LaneBlock start_lane = {};
+        set_lane_bit(start_lane, lane);
+        reached[start] |= start_lane;
+        frontier[start] |= start_lane;
+        is_frontier_row[starts[lane].row + 1] = 1;
+        parity_counts[0].add(start_lane);
+    }
+
+    // The budgets are ascending, every budget takes the counts once the BFS reached its depth or ended
+    auto record_counts = [&](std::size_t budget_index) {
+        for (std::size_t lane = 0; lane < start_count; ++lane) {
+            auto& lane_counts = counts[lane * budgets.size() + budget_index];
+            lane_counts.even = parity_counts[0].get(lane);
+            lane_counts.odd = parity_counts[1].get(lane);
+        }
+    };
+
+    std::size_t budget_index = 0;
+    std::size_t steps = 0;
+    for (bool is_growing = true; is_growing && budget_index < budgets.size(); ++steps) {
+        for (; budget_index < budgets.size() && budgets[budget_index] == steps; ++budget_index) {
+            record_counts(budget_index);
+        }
+
+        is_growing = false;
+        for (int row = 0; row < map.rows; ++row) {
+            auto row_start = map.index(row, 0);
+            if (!is_frontier_row[row] && !is_frontier_row[row + 1] && !is_frontier_row[row + 2]) {
+                if (is_next_frontier_row[row + 1]) {  // Left over from the step before
+                    std::fill_n(next_frontier.begin() + row_start, map.cols, LaneBlock{});
+                    is_next_frontier_row[row + 1] = 0;
+                }
                 continue;
             }
 
-            seen.insert(pos);
-            queue.push_back(PositionState(row, col, current.steps - 1));
+            const LaneBlock* current = frontier.data() + row_start;
+            const LaneBlock* above = current - map.stride;
+            const LaneBlock* below = current + map.stride;
+            LaneBlock* row_reached = reached.data() + row_start;
+            LaneBlock* next = next_frontier.data() + row_start;
+            LaneBlock row_grown = {};
+            for (int col = 0; col < map.cols; ++col) {
+                auto lanes = (above[col] | below[col] | current[col - 1] | current[col + 1]) & ~row_reached[col];
+                row_reached[col] |= lanes;
+                next[col] = lanes;
+                row_grown |= lanes;
+            }
+
+            is_next_frontier_row[row + 1] = !is_empty(row_grown);
+            if (is_next_frontier_row[row + 1]) {
+                parity_counts[(steps + 1) % 2].add_all(next, map.cols);
+                is_growing = true;
+            }
         }
+        frontier.swap(next_frontier);
+        is_frontier_row.swap(is_next_frontier_row);
+    }
+    TRACE_ADD("sweeps", steps);
+
+    for (; budget_index < budgets.size(); ++budget_index) {
+        record_counts(budget_index);
     }
-    return answer.size();
+}
+
+// counts[s * budgets.size() + b] are the fields reachable from starts[s] within budgets[b] steps, which have to be
+// ascending. The starts are swept in groups of MULTI_SOURCE_LANES on the thread pool.
+std::vector<ReachableCounts> count_fields_multi_source(const Map& map, const std::vector<Position>& starts,
+                                                       const std::vector<std::size_t>& budgets) {
+    TRACE_SCOPE("count_fields_multi_source");
+    assert(std::is_sorted(budgets.begin(), budgets.end()));
+    std::vector<ReachableCounts> counts(starts.size() * budgets.size());
+    auto group_count = (starts.size() + MULTI_SOURCE_LANES - 1) / MULTI_SOURCE_LANES;
+    parallel_for(group_count, [&](std::size_t group) {
+        auto first = group * MULTI_SOURCE_LANES;
+        auto start_count = std::min<std::size_t>(MULTI_SOURCE_LANES, starts.size() - first);
+        count_fields_in_lanes(map, &starts[first], start_count, budgets, &counts[first * budgets.size()]);
+    });
+    return counts;
+}
+
+std::vector<Position> read_starts_or_panic(const Map& map, const char* filename) {
+    std::size_t input_size;
+    char* input = read_file_or_panic(filename, &input_size);
+    std::vector<Position> starts;
+    parse::LineReader lines(input, input_size);
+    std::string_view line;
+    while (lines.next(line)) {
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue;
+        }
+        // Every other line is exactly "<ROW> <COL>" of a garden plot
+        std::string text(line);
+        int row, col, length = 0;
+        if (sscanf(text.c_str(), "%d %d %n", &row, &col, &length) != 2 || text[length] != '\0' || row < 0 ||
+            row >= map.rows || col < 0 || col >= map.cols || map[map.index(row, col)] == '#') {
+            fprintf(stderr, "Invalid start '%s'\n", text.c_str());
+            exit(EXIT_FAILURE);
+        }
+        starts.push_back(Position(row, col));
+    }
+    free(input);
+    return starts;
+}
+
+// The resident state of the query server
+struct GardenQueries {
+    Garden garden;
+    std::vector<std::size_t> start_fields_by_steps;
+};
+
+// Server query "<STEPS>" from the start or "<ROW> <COL> <STEPS>" from any garden plot, replies with count_fields
+int handle_steps_query(void* state, const char* query, char* reply, std::size_t reply_size) {
+    const auto& queries = *static_cast<const GardenQueries*>(state);
+    const auto& map = queries.garden.map;
+    long long row = queries.garden.start.row, col = queries.garden.start.col, steps;
+    int length = 0;
+    bool is_from_start = sscanf(query, "%lld%n", &steps, &length) == 1 && query[length] == '\0';
+    if (!is_from_start &&
+        (sscanf(query, "%lld %lld %lld%n", &row, &col, &steps, &length) != 3 || query[length] != '\0')) {
+        return 0;
+    }
+    if (steps < 0 || row < 0 || row >= map.rows || col < 0 || col >= map.cols || map[map.index(row, col)] == '#') {
+        return 0;
+    }
+
+    // No field is further away than the number of fields, so larger budgets only keep their parity
+    long long field_count = (long long)map.rows * map.cols;
+    if (steps > field_count) {
+        steps = field_count + (steps - field_count) % 2;
+    }
+
+    std::size_t fields;
+    const auto& table = queries.start_fields_by_steps;
+    if (is_from_start || (row == queries.garden.start.row && col == queries.garden.start.col)) {
+        auto last = table.size() - 1;
+        fields = (std::size_t)steps <= last ? table[steps] : table[last - (last - steps) % 2];
+    } else {
+        fields = count_fields(map, (int)row, (int)col, (int)steps);
+    }
+    snprintf(reply, reply_size, "%zu", fields);
+    return 1;
 }
 
 std::size_t square(std::size_t x) { return x * x; }
 
-int main(int argc, char** argv) {
-    auto map = read_map(argv[1]);
-    auto start = find_start(map);
+void* solver_parse(const char* input, std::size_t input_size) {
+    TRACE_SCOPE("parse");
+    auto garden = new Garden();
+    if (!try_read_padded_grid(input, input_size, '#', garden->map)) {
+        fprintf(stderr, "All rows of the garden need the same length\n");
+        delete garden;
+        return nullptr;
+    }
+    return garden;
+}
 
-    std::cout << "Part 1: " << count_fields(map, start.row, start.col, 64) << "\n";
+int solver_prepare(void* state) {
+    TRACE_SCOPE("prepare");
+    auto garden = static_cast<Garden*>(state);
+    if (!find_start(garden->map, garden->start)) {
+        fprintf(stderr, "The garden has no start\n");
+        return 0;
+    }
+    return 1;
+}
 
-    std::size_t steps = 26501365;
-    assert_input_properties(map, start, steps);
-    auto map_size = map.size();
+int solver_solve(void* state, SolverAnswers* answers) {
+    TRACE_SCOPE("solve");
+    const auto& map = static_cast<const Garden*>(state)->map;
+    const auto& start = static_cast<const Garden*>(state)->start;
+
+    answers->part_1 = count_fields(map, start.row, start.col, 64);
+
+#ifdef AOC_BENCH
+    // Generated gardens of any odd size keep the number of repeated maps of the 131 wide puzzle input
+    std::size_t steps = PART_2_MAP_REPETITIONS * map.rows + map.rows / 2;
+#else
+    std::size_t steps = PART_2_STEPS;
+#endif
+    if (!has_input_properties(map, start, steps)) {
+        fprintf(stderr, "The garden needs to be square with the start in its center\n");
+        return 0;
+    }
+    std::size_t map_size = map.rows;
     auto grid_radius = steps / map_size - 1;
 
     auto even_maps = square((grid_radius + 1) / 2 * 2);
@@ -126,30 +454,79 @@ int main(int argc, char** argv) {
     part_2 += even_maps * count_fields(map, start.row, start.col, map_size * 2);    // Some big enough even number
     part_2 += odd_maps * count_fields(map, start.row, start.col, map_size * 2 + 1); // Some big enough odd number
 
-    std::cout << "Part 2: " << part_2 << "\n";
-
     // Count the four corner maps in the grid of maps
     part_2 += count_fields(map, map_size - 1, start.col, map_size - 1);
     part_2 += count_fields(map, start.row, 0, map_size - 1);
     part_2 += count_fields(map, 0, start.col, map_size - 1);
     part_2 += count_fields(map, start.row, map_size - 1, map_size - 1);
 
-    std::cout << "Part 2: " << part_2 << "\n";
-
     // Count the outer edge maps
     part_2 += (grid_radius + 1) * count_fields(map, map_size - 1, 0, map_size / 2 - 1);
     part_2 += (grid_radius + 1) * count_fields(map, 0, 0, map_size / 2 - 1);
     part_2 += (grid_radius + 1) * count_fields(map, 0, map_size - 1, map_size / 2 - 1);
     part_2 += (grid_radius + 1) * count_fields(map, map_size - 1, map_size - 1, map_size / 2 - 1);
 
-    std::cout << "Part 2: " << part_2 << "\n";
     // Coount the inner edge maps
     part_2 += grid_radius * count_fields(map, map_size - 1, 0, map_size * 3 / 2 - 1);
     part_2 += grid_radius * count_fields(map, 0, 0, map_size * 3 / 2 - 1);
     part_2 += grid_radius * count_fields(map, 0, map_size - 1, map_size * 3 / 2 - 1);
     part_2 += grid_radius * count_fields(map, map_size - 1, map_size - 1, map_size * 3 / 2 - 1);
 
-    std::cout << "Part 2: " << part_2 << "\n";
+    answers->part_2 = part_2;
+    answers->has_part_2 = 1;
+    return 1;
+}
+
+void solver_release(void* state) { delete static_cast<Garden*>(state); }
 
-    return 0;
-}
\ No newline at end of file
+const Solver DAY21_SOLVER = {"day21", 1, solver_parse, solver_prepare, solver_solve, solver_release};
+
+int main(int argc, const char** argv) {
+    if (argc >= 5 && strcmp(argv[1], "--multi-source") == 0) {  // Counts of many starts and budgets in one sweep
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        auto map = read_padded_grid(input, input_size, '#');
+        free(input);
+        auto starts = read_starts_or_panic(map, argv[3]);
+
+        std::vector<std::size_t> requested_budgets;
+        for (int i = 4; i < argc; ++i) {
+            requested_budgets.push_back(parse_count_or_panic(argv[i], "step budget"));
+        }
+        auto budgets = requested_budgets;
+        std::sort(budgets.begin(), budgets.end());
+        budgets.erase(std::unique(budgets.begin(), budgets.end()), budgets.end());
+
+        // One line per start with "<EVEN>/<ODD>" per budget in the order of the arguments
+        auto counts = count_fields_multi_source(map, starts, budgets);
+        for (std::size_t s = 0; s < starts.size(); ++s) {
+            printf("%d %d:", starts[s].row, starts[s].col);
+            for (auto budget : requested_budgets) {
+                auto b = std::lower_bound(budgets.begin(), budgets.end(), budget) - budgets.begin();
+                const auto& count = counts[s * budgets.size() + b];
+                printf(" %zu/%zu", count.even, count.odd);
+            }
+            printf("\n");
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (argc == 4 && strcmp(argv[1], SERVE_FLAG) == 0) {  // Answer step queries on a socket, the garden stays resident
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        GardenQueries queries;
+        queries.garden.map = read_padded_grid(input, input_size, '#');
+        if (!find_start(queries.garden.map, queries.garden.start)) {
+            fprintf(stderr, "The garden has no start\n");
+            exit(EXIT_FAILURE);
+        }
+        queries.start_fields_by_steps =
+            count_fields_by_steps(queries.garden.map, queries.garden.start.row, queries.garden.start.col);
+        free(input);
+
+        serve_queries(argv[3], handle_steps_query, &queries);
+        exit(EXIT_SUCCESS);
+    }
+
+    return solver_main(argc, argv, &DAY21_SOLVER);
+}
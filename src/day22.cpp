@@ -1,34 +1,44 @@
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <deque>
-#include <fstream>
-#include <iostream>
+#include <fcntl.h>
+#include <numeric>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "arena.hpp"
+#include "parallel.hpp"
+#include "parse.hpp"
+#include "solver.h"
+#include "trace.hpp"
+
+#define SNAPSHOT_MAGIC "AOC22STK"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 40
+
 struct Vector3 {
     int x, y, z;
     Vector3() {}
-    Vector3(std::string text) {
-        auto first_comma = text.find_first_of(',');
-        auto last_comma = text.find_last_of(',');
 
-        this->x = std::stoi(text.substr(0, first_comma));
-        this->y = std::stoi(text.substr(first_comma + 1, last_comma - first_comma));
-        this->z = std::stoi(text.substr(last_comma + 1, text.length() - 1 - last_comma));
+    // Takes the next three numbers of text, returns false if it holds fewer
+    bool take(std::string_view& text) {
+        return parse::try_take_number(text, x) && parse::try_take_number(text, y) && parse::try_take_number(text, z);
     }
 };
 
 struct Brick {
     Vector3 start, end;
 
-    Brick(const std::string line) {
-        auto tilde_index = line.find('~');
-        auto start = line.substr(0, tilde_index);
-        auto end = line.substr(tilde_index + 1, line.length() - 1 - tilde_index);
+    Brick() {}
 
-        this->start = Vector3(start);
-        this->end = Vector3(end);
-    }
+    bool read(std::string_view line) { return start.take(line) && end.take(line); }
 
     int get_lowest_x() const { return std::min(start.x, end.x); }
 
@@ -55,7 +65,9 @@ struct Brick {
 struct SupportMap {
     std::vector<std::vector<std::size_t>> supports, supported_by;
 
+    SupportMap() {}
     SupportMap(const std::vector<Brick>& bricks) {
+        TRACE_SCOPE("build_support_map");
         for (std::size_t i = 0; i < bricks.size(); ++i) {
             supports.push_back(std::vector<std::size_t>());
             supported_by.push_back(std::vector<std::size_t>());
@@ -67,16 +79,40 @@ struct SupportMap {
                     bricks[i].overlaps_with(bricks[i_below])) {
                     supports[i_below].push_back(i);
                     supported_by[i].push_back(i_below);
+                    TRACE_ADD("supports", 1);
                 }
             }
+            TRACE_ADD("support_checks", i);
         }
     }
+
+    std::size_t get_brick_count() const { return supports.size(); }
+
+    std::size_t get_support_count(std::size_t brick) const { return supports[brick].size(); }
+
+    std::size_t get_support(std::size_t brick, std::size_t i) const { return supports[brick][i]; }
+
+    std::size_t get_supporter_count(std::size_t brick) const { return supported_by[brick].size(); }
+
+    std::size_t get_supporter(std::size_t brick, std::size_t i) const { return supported_by[brick][i]; }
+};
+
+struct Tower {
+    std::vector<Brick> bricks;
+    SupportMap map;
+};
+
+struct BrickStack {
+    std::vector<Brick> bricks;
+    std::vector<Tower> towers;
 };
 
 bool brick_z_comparer(const Brick& lhs, const Brick& rhs) { return lhs.get_lowest_z() < rhs.get_lowest_z(); }
 
 void drop_bricks(std::vector<Brick>& bricks) {
+    TRACE_SCOPE("drop_bricks");
     for (std::size_t i = 0; i < bricks.size(); ++i) {
+        TRACE_ADD("overlap_checks", i);
         int z = 1;
         for (std::size_t i_below = 0; i_below < i; ++i_below) {
             if (bricks[i].overlaps_with(bricks[i_below])) {
@@ -89,12 +125,61 @@ void drop_bricks(std::vector<Brick>& bricks) {
     }
 }
 
-std::size_t part_1(const SupportMap& map) {
+std::size_t find_root(std::vector<std::size_t>& parents, std::size_t i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+bool is_larger_tower(const Tower& lhs, const Tower& rhs) { return lhs.bricks.size() > rhs.bricks.size(); }
+
+// Bricks can only rest on bricks whose footprints overlap theirs, so every group of bricks connected by overlapping
+// footprints is a tower that settles independently of the others. The towers are ordered largest first.
+std::vector<Tower> split_into_towers(const std::vector<Brick>& bricks) {
+    TRACE_SCOPE("split_into_towers");
+    std::vector<std::size_t> parents(bricks.size());
+    std::iota(parents.begin(), parents.end(), 0);
+
+    // Union-find over the x/y cells, every brick joins the first brick that covered each of its cells
+    std::unordered_map<std::uint64_t, std::size_t> cell_owners;
+    for (std::size_t i = 0; i < bricks.size(); ++i) {
+        for (int x = bricks[i].get_lowest_x(); x <= bricks[i].get_highest_x(); ++x) {
+            for (int y = bricks[i].get_lowest_y(); y <= bricks[i].get_highest_y(); ++y) {
+                auto cell = (std::uint64_t(std::uint32_t(x)) << 32) | std::uint32_t(y);
+                auto owner = cell_owners.insert({cell, i});
+                if (!owner.second) {
+                    parents[find_root(parents, i)] = find_root(parents, owner.first->second);
+                }
+            }
+        }
+    }
+
+    std::vector<Tower> towers;
+    std::vector<std::size_t> tower_ids(bricks.size(), bricks.size());
+    for (std::size_t i = 0; i < bricks.size(); ++i) {
+        auto root = find_root(parents, i);
+        if (tower_ids[root] == bricks.size()) {
+            tower_ids[root] = towers.size();
+            towers.emplace_back();
+        }
+        towers[tower_ids[root]].bricks.push_back(bricks[i]);
+    }
+    TRACE_ADD("towers", towers.size());
+
+    std::sort(towers.begin(), towers.end(), is_larger_tower);
+    return towers;
+}
+
+// The counting works on any support map with the accessors of SupportMap, like the towers of a StackSnapshot
+template <typename Map>
+std::size_t part_1(const Map& map) {
     std::size_t result = 0;
-    for (std::size_t i = 0; i < map.supports.size(); ++i) {
+    for (std::size_t i = 0; i < map.get_brick_count(); ++i) {
         bool can_be_removed = true;
-        for (const auto& supported : map.supports[i]) {
-            if (map.supported_by[supported].size() < 2) {
+        for (std::size_t j = 0; j < map.get_support_count(i); ++j) {
+            if (map.get_supporter_count(map.get_support(i, j)) < 2) {
                 can_be_removed = false;
                 break;
             }
@@ -106,24 +191,29 @@ std::size_t part_1(const SupportMap& map) {
     return result;
 }
 
-std::size_t count_brick_falls(const SupportMap& map, std::size_t brick) {
-    std::deque<std::size_t> queue;
-    std::unordered_set<std::size_t> falling;
+template <typename Map>
+std::size_t count_brick_falls(const Map& map, std::size_t brick) {
+    TRACE_SCOPE("count_brick_falls");
+    auto memory = get_scratch_arena().reset();
+    std::pmr::deque<std::size_t> queue(memory);
+    std::pmr::unordered_set<std::size_t> falling(memory);
     queue.push_back(brick);
     falling.insert(brick);
 
     while (queue.size() > 0) {
         auto current = queue.front();
         queue.pop_front();
+        TRACE_ADD("expansions", 1);
 
-        for (auto supported : map.supports[current]) {
+        for (std::size_t i = 0; i < map.get_support_count(current); ++i) {
+            auto supported = map.get_support(current, i);
             if (falling.count(supported)) {
                 continue;
             }
 
             bool all_supports_are_falling = true;
-            for (auto supports : map.supported_by[supported]) {
-                if (!falling.count(supports)) {
+            for (std::size_t j = 0; j < map.get_supporter_count(supported); ++j) {
+                if (!falling.count(map.get_supporter(supported, j))) {
                     all_supports_are_falling = false;
                     break;
                 }
@@ -132,39 +222,334 @@ std::size_t count_brick_falls(const SupportMap& map, std::size_t brick) {
             if (all_supports_are_falling) {
                 queue.push_back(supported);
                 falling.insert(supported);
+                TRACE_MAX("max_queue", queue.size());
             }
         }
     }
 
+    TRACE_ADD("fallen", falling.size() - 1);
     return falling.size() - 1;
 }
 
-std::size_t part_2(const SupportMap& map) {
+template <typename Map>
+std::size_t part_2(const Map& map) {
     std::size_t result = 0;
-    for (std::size_t i = 0; i < map.supports.size(); ++i) {
+    for (std::size_t i = 0; i < map.get_brick_count(); ++i) {
         result += count_brick_falls(map, i);
     }
     return result;
 }
 
-int main(int argc, const char** argv) {
-    std::vector<Brick> bricks;
-    std::ifstream file(argv[1]);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            bricks.push_back(Brick(line));
+// Counts every tower on the thread pool, get_map(i) returns the support map of the i-th tower
+template <typename GetMap>
+void count_towers(std::size_t tower_count, GetMap get_map, SolverAnswers* answers) {
+    std::vector<std::size_t> part_1_counts(tower_count), part_2_counts(tower_count);
+    parallel_for(tower_count, [&](std::size_t i) {
+        const auto& map = get_map(i);
+        part_1_counts[i] = part_1(map);
+        part_2_counts[i] = part_2(map);
+    });
+
+    answers->part_1 = std::accumulate(part_1_counts.begin(), part_1_counts.end(), std::size_t(0));
+    answers->part_2 = std::accumulate(part_2_counts.begin(), part_2_counts.end(), std::size_t(0));
+    answers->has_part_2 = 1;
+}
+
+// Snapshot of a settled stack, all integers are little endian:
+//   header   magic "AOC22STK", u32 version, u32 reserved, u64 towers T, u64 bricks N, u64 supports E
+//   u64[T + 1]   first brick of every tower, the last entry is N
+//   i32[N][6]    settled bricks as start x/y/z and end x/y/z, ordered by z within their tower
+//   u64[N + 1]   first entry of every brick in the supported list, the last entry is E
+//   u32[E]       supported bricks as index within the tower
+//   u64[N + 1]   first entry of every brick in the supporter list, the last entry is E
+//   u32[E]       supporting bricks as index within the tower
+void append_le(std::vector<unsigned char>& bytes, std::uint64_t value, int size) {
+    for (int i = 0; i < size; ++i) {
+        bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+std::uint64_t load_le(const unsigned char* bytes, int size) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < size; ++i) {
+        value |= std::uint64_t(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+void append_adjacency(std::vector<unsigned char>& bytes, const std::vector<Tower>& towers,
+                      const std::vector<std::vector<std::size_t>> SupportMap::*lists) {
+    std::uint64_t entries = 0;
+    for (const auto& tower : towers) {
+        for (const auto& list : tower.map.*lists) {
+            append_le(bytes, entries, 8);
+            entries += list.size();
+        }
+    }
+    append_le(bytes, entries, 8);
+
+    for (const auto& tower : towers) {
+        for (const auto& list : tower.map.*lists) {
+            for (auto brick : list) {
+                append_le(bytes, brick, 4);
+            }
+        }
+    }
+}
+
+void write_snapshot(const std::vector<Tower>& towers, const char* filename) {
+    std::uint64_t brick_count = 0, support_count = 0;
+    for (const auto& tower : towers) {
+        brick_count += tower.bricks.size();
+        for (const auto& supports : tower.map.supports) {
+            support_count += supports.size();
+        }
+    }
+
+    std::vector<unsigned char> bytes(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + SNAPSHOT_MAGIC_SIZE);
+    append_le(bytes, SNAPSHOT_VERSION, 4);
+    append_le(bytes, 0, 4);
+    append_le(bytes, towers.size(), 8);
+    append_le(bytes, brick_count, 8);
+    append_le(bytes, support_count, 8);
+
+    std::uint64_t first_brick = 0;
+    for (const auto& tower : towers) {
+        append_le(bytes, first_brick, 8);
+        first_brick += tower.bricks.size();
+    }
+    append_le(bytes, first_brick, 8);
+
+    for (const auto& tower : towers) {
+        for (const auto& brick : tower.bricks) {
+            for (auto coordinate : {brick.start.x, brick.start.y, brick.start.z, brick.end.x, brick.end.y, brick.end.z}) {
+                append_le(bytes, static_cast<std::uint32_t>(coordinate), 4);
+            }
+        }
+    }
+
+    append_adjacency(bytes, towers, &SupportMap::supports);
+    append_adjacency(bytes, towers, &SupportMap::supported_by);
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL || fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size() || fclose(file) != 0) {
+        fprintf(stderr, "Unable to write the snapshot '%s'\n", filename);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Adjacency lists of a snapshot, read in place from the mapped file
+struct SnapshotLists {
+    const unsigned char* offsets;
+    const unsigned char* entries;
+
+    std::size_t get_count(std::size_t brick) const {
+        return load_le(offsets + 8 * (brick + 1), 8) - load_le(offsets + 8 * brick, 8);
+    }
+
+    std::size_t get(std::size_t brick, std::size_t i) const {
+        return load_le(entries + 4 * (load_le(offsets + 8 * brick, 8) + i), 4);
+    }
+};
+
+// One tower of a snapshot with the accessors of SupportMap
+struct SnapshotTower {
+    SnapshotLists supports, supported_by;
+    std::size_t first_brick, brick_count;
+
+    std::size_t get_brick_count() const { return brick_count; }
+
+    std::size_t get_support_count(std::size_t brick) const { return supports.get_count(first_brick + brick); }
+
+    std::size_t get_support(std::size_t brick, std::size_t i) const { return supports.get(first_brick + brick, i); }
+
+    std::size_t get_supporter_count(std::size_t brick) const { return supported_by.get_count(first_brick + brick); }
+
+    std::size_t get_supporter(std::size_t brick, std::size_t i) const {
+        return supported_by.get(first_brick + brick, i);
+    }
+};
+
+// Read only memory mapping of a snapshot file. The layout is checked once when it is opened, so the queries can
+// read the lists without any further bounds checks.
+class StackSnapshot {
+   public:
+    StackSnapshot(const char* filename) : filename(filename) {
+        int fd = open(filename, O_RDONLY);
+        struct stat status;
+        if (fd < 0 || fstat(fd, &status) != 0) {
+            panic("can not be opened");
+        }
+        size = static_cast<std::size_t>(status.st_size);
+        void* mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            panic("can not be mapped");
         }
-        file.close();
+        data = static_cast<const unsigned char*>(mapping);
+
+        if (size < SNAPSHOT_HEADER_SIZE || std::memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0) {
+            panic("is no brick stack snapshot");
+        }
+        if (load_le(data + 8, 4) != SNAPSHOT_VERSION) {
+            panic("has an unsupported version");
+        }
+        tower_count = load_le(data + 16, 8);
+        brick_count = load_le(data + 24, 8);
+        support_count = load_le(data + 32, 8);
+        check_layout();
+    }
+
+    ~StackSnapshot() { munmap(const_cast<unsigned char*>(data), size); }
+
+    StackSnapshot(const StackSnapshot&) = delete;
+    StackSnapshot& operator=(const StackSnapshot&) = delete;
+
+    std::size_t get_tower_count() const { return tower_count; }
+
+    SnapshotTower get_tower(std::size_t tower) const {
+        auto first_brick = load_le(tower_offsets + 8 * tower, 8);
+        auto end_brick = load_le(tower_offsets + 8 * (tower + 1), 8);
+        return {supports, supported_by, first_brick, end_brick - first_brick};
     }
 
-    std::sort(bricks.begin(), bricks.end(), brick_z_comparer);
-    drop_bricks(bricks);
-    std::sort(bricks.begin(), bricks.end(), brick_z_comparer);
-    SupportMap map(bricks);
+   private:
+    const char* filename;
+    const unsigned char* data = nullptr;
+    std::size_t size = 0;
+    std::uint64_t tower_count = 0, brick_count = 0, support_count = 0;
+    const unsigned char* tower_offsets = nullptr;
+    SnapshotLists supports{}, supported_by{};
 
-    std::cout << "Part 1: " << part_1(map) << "\n";
-    std::cout << "Part 2: " << part_2(map) << "\n";
+    [[noreturn]] void panic(const char* reason) const {
+        fprintf(stderr, "The snapshot '%s' %s\n", filename, reason);
+        exit(EXIT_FAILURE);
+    }
+
+    void check_offsets(const unsigned char* offsets, std::size_t count, std::uint64_t last) const {
+        std::uint64_t previous = 0;
+        for (std::size_t i = 0; i <= count; ++i) {
+            auto offset = load_le(offsets + 8 * i, 8);
+            if (offset < previous || (i == 0 && offset != 0) || (i == count && offset != last)) {
+                panic("has invalid offsets");
+            }
+            previous = offset;
+        }
+    }
 
-    return 0;
-}
\ No newline at end of file
+    // Every list entry has to be a brick of the tower that owns the list
+    void check_entries(const SnapshotLists& lists) const {
+        for (std::size_t tower = 0; tower < tower_count; ++tower) {
+            auto tower_bricks = get_tower(tower).brick_count;
+            auto first_brick = load_le(tower_offsets + 8 * tower, 8);
+            for (std::size_t brick = first_brick; brick < first_brick + tower_bricks; ++brick) {
+                for (std::size_t i = 0; i < lists.get_count(brick); ++i) {
+                    if (lists.get(brick, i) >= tower_bricks) {
+                        panic("has a support outside of its tower");
+                    }
+                }
+            }
+        }
+    }
+
+    void check_layout() {
+        auto max_count = size / 4;
+        if (tower_count > max_count || brick_count > max_count || support_count > max_count) {
+            panic("is truncated");
+        }
+
+        auto expected_size = SNAPSHOT_HEADER_SIZE + 8 * (tower_count + 1) + 24 * brick_count +
+                             2 * (8 * (brick_count + 1) + 4 * support_count);
+        if (size != expected_size) {
+            panic("is truncated");
+        }
+
+        tower_offsets = data + SNAPSHOT_HEADER_SIZE;
+        supports.offsets = tower_offsets + 8 * (tower_count + 1) + 24 * brick_count;
+        supports.entries = supports.offsets + 8 * (brick_count + 1);
+        supported_by.offsets = supports.entries + 4 * support_count;
+        supported_by.entries = supported_by.offsets + 8 * (brick_count + 1);
+
+        check_offsets(tower_offsets, tower_count, brick_count);
+        check_offsets(supports.offsets, brick_count, support_count);
+        check_offsets(supported_by.offsets, brick_count, support_count);
+        check_entries(supports);
+        check_entries(supported_by);
+    }
+};
+
+void* solver_parse(const char* input, std::size_t input_size) {
+    TRACE_SCOPE("parse");
+    auto stack = new BrickStack();
+
+    stack->bricks.reserve(input_size / 16);
+    parse::LineReader lines(input, input_size);
+    std::string_view line;
+    while (lines.next(line)) {
+        Brick brick;
+        if (!brick.read(line)) {
+            fprintf(stderr, "Malformed brick in line %zu\n", stack->bricks.size() + 1);
+            delete stack;
+            return nullptr;
+        }
+        stack->bricks.push_back(brick);
+    }
+
+    return stack;
+}
+
+int solver_prepare(void* state) {
+    TRACE_SCOPE("prepare");
+    auto stack = static_cast<BrickStack*>(state);
+
+    stack->towers = split_into_towers(stack->bricks);
+    std::vector<Brick>().swap(stack->bricks);
+
+    parallel_for(stack->towers.size(), [stack](std::size_t i) {
+        auto& tower = stack->towers[i];
+        std::sort(tower.bricks.begin(), tower.bricks.end(), brick_z_comparer);
+        drop_bricks(tower.bricks);
+        std::sort(tower.bricks.begin(), tower.bricks.end(), brick_z_comparer);
+        tower.map = SupportMap(tower.bricks);
+    });
+    return 1;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    TRACE_SCOPE("solve");
+    const auto& towers = static_cast<const BrickStack*>(state)->towers;
+    count_towers(
+        towers.size(), [&](std::size_t i) -> const SupportMap& { return towers[i].map; }, answers);
+    return 1;
+}
+
+void solver_release(void* state) { delete static_cast<BrickStack*>(state); }
+
+const Solver DAY22_SOLVER = {"day22", 1, solver_parse, solver_prepare, solver_solve, solver_release};
+
+int main(int argc, const char** argv) {
+    if (argc == 4 && strcmp(argv[1], "--save-snapshot") == 0) {  // Settle the stack once and store it
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        auto stack = static_cast<BrickStack*>(solver_parse(input, input_size));
+        if (stack == nullptr) {
+            exit(EXIT_FAILURE);
+        }
+        solver_prepare(stack);
+        write_snapshot(stack->towers, argv[3]);
+        solver_release(stack);
+        free(input);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--snapshot") == 0) {  // Count on a stored stack without parsing or settling
+        StackSnapshot snapshot(argv[2]);
+        SolverAnswers answers;
+        count_towers(
+            snapshot.get_tower_count(), [&](std::size_t i) { return snapshot.get_tower(i); }, &answers);
+        print_answers(&answers);
+        exit(EXIT_SUCCESS);
+    }
+
+    return solver_main(argc, argv, &DAY22_SOLVER);
+}
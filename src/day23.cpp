@@ -1,151 +1,230 @@
 #include <algorithm>
-#include <cassert>
-#include <deque>
-#include <fstream>
-#include <iostream>
+#include <cstdint>
+#include <set>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
-const int DR[] = {-1, 1, 0, 0};
-const int DC[] = {0, 0, -1, 1};
+#include "arena.hpp"
+#include "grid.hpp"
+#include "solver.h"
+#include "trace.hpp"
 
-using Map = std::vector<std::string>;
+#define MAX_MITM_VERTICES 64
+#define MAX_SEPARATOR_VERTICES 8
 
-struct Position {
-    int row, col;
-    Position(int row, int col) : row(row), col(col) {}
-    bool operator==(const Position& other) const { return this->row == other.row && this->col == other.col; }
+const char SLOPES[GRID_NEIGHBOURS] = {'^', 'v', '<', '>'};
+
+using Map = PaddedGrid;
+
+using Edges = std::unordered_map<std::size_t, std::size_t>;
+using Graph = std::unordered_map<std::size_t, Edges>;
+
+struct FieldState {
+    std::size_t index;
+    std::size_t steps;
+    FieldState(std::size_t index, std::size_t steps) : index(index), steps(steps) {}
 };
 
-class PositionHash {
-   public:
-    std::size_t operator()(const Position& pos) const { return 1000 * pos.row + pos.col; }
+struct JunctionEdge {
+    int target;
+    std::size_t cost;
 };
 
-using Edges = std::unordered_map<Position, std::size_t, PositionHash>;
-using Graph = std::unordered_map<Position, Edges, PositionHash>;
+// Graph with the vertices numbered densely, so a set of vertices fits into a 64 bit mask.
+// offset is the length every start to end path has in addition to its edges.
+struct JunctionGraph {
+    std::vector<std::vector<JunctionEdge>> edges;
+    int start = 0, end = 0;
+    std::size_t offset = 0;
+};
 
-using PositionSet = std::unordered_set<Position, PositionHash>;
+// Mutable junction graph for the reduction, which also needs the incoming edges of a vertex
+struct ReducibleGraph {
+    std::vector<std::unordered_map<int, std::size_t>> out, in;
+    std::vector<char> removed;
+    int start = 0, end = 0;
+    std::size_t offset = 0;
+
+    ReducibleGraph(const JunctionGraph& graph)
+        : out(graph.edges.size()), in(graph.edges.size()), removed(graph.edges.size(), 0), start(graph.start),
+          end(graph.end), offset(graph.offset) {
+        for (std::size_t from = 0; from < graph.edges.size(); ++from) {
+            for (const auto& edge : graph.edges[from]) {
+                add_edge(static_cast<int>(from), edge.target, edge.cost);
+            }
+        }
+    }
 
-struct PositionState {
-    Position pos;
-    std::size_t steps;
-    PositionState(int row, int col, std::size_t steps) : pos(row, col), steps(steps) {}
-};
+    // Parallel edges are merged, only the longer one can be part of a longest path
+    void add_edge(int from, int to, std::size_t cost) {
+        auto& current = out[from][to];
+        current = std::max(current, cost);
+        in[to][from] = current;
+    }
 
-Map read_map(const char* filename) {
-    Map map;
-    std::ifstream file(filename);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            map.push_back(line);
+    void remove_edge(int from, int to) {
+        out[from].erase(to);
+        in[to].erase(from);
+    }
+
+    void remove_vertex(int vertex) {
+        for (const auto& edge : out[vertex]) {
+            in[edge.first].erase(vertex);
+        }
+        for (const auto& edge : in[vertex]) {
+            out[edge.first].erase(vertex);
         }
-        file.close();
+        out[vertex].clear();
+        in[vertex].clear();
+        removed[vertex] = 1;
     }
-    return map;
-}
 
-int find_first_path_field(const std::string& line) {
-    for (int i = 0; i < line.length(); ++i) {
-        if (line[i] == '.') {
-            return i;
+    std::vector<int> get_neighbours(int vertex) const {
+        std::vector<int> neighbours;
+        for (const auto& edge : out[vertex]) {
+            neighbours.push_back(edge.first);
+        }
+        for (const auto& edge : in[vertex]) {
+            if (!out[vertex].count(edge.first)) {
+                neighbours.push_back(edge.first);
+            }
         }
+        return neighbours;
     }
-    assert(false);
-}
+};
+
+struct BlockSearch {
+    std::vector<std::vector<int>> neighbours;
+    std::vector<int> discovered, low;
+    std::vector<std::pair<int, int>> edge_stack;
+    std::set<std::pair<int, int>> kept;
+    std::pair<int, int> start_end;
+    int time = 0;
+};
+
+enum class Side : char { START, LAYER, END, NONE };
+
+// Junctions of a separator layer and the side of every other junction, see find_separator_layer
+struct SeparatorLayer {
+    std::vector<Side> sides;
+    std::vector<int> vertices;
+    std::vector<int> indices;  // Position of a junction in vertices, -1 if it is not in the layer
+};
+
+using SignatureLengths = std::pmr::unordered_map<std::uint64_t, std::size_t>;
+
+// Pieces of one side of the layer. A signature holds the index + 1 of the first (last) layer junction of the path in
+// its low 4 bits and the target index + 1 of the link from every layer junction in the following groups of 4 bits.
+struct SideSearch {
+    const JunctionGraph& graph;
+    const SeparatorLayer& layer;
+    Side side;
+    SignatureLengths& lengths;
+};
+
+// Expansion of the signatures of one side into orders of the layer junctions
+struct OrderSearch {
+    Side side;
+    std::size_t layer_size;
+    SignatureLengths& start_lengths;  // Per order of the start side
+    std::uint64_t signature = 0;
+    std::size_t length = 0;
+    int anchor = 0;
+    std::uint64_t linked = 0;
+    std::size_t link_count = 0;
+    bool is_valid = false;
+    std::size_t result = 0;
+};
 
-bool is_legal_waypoint(const Map& map, const Position& pos) {
-    auto rows = map.size();
-    auto cols = map[0].length();
+struct Maze {
+    Map map;
+    std::size_t start = 0;
+    std::size_t end = 0;
+    JunctionGraph junctions1, junctions2;
+    SeparatorLayer layer2;
+};
 
-    return pos.row >= 0 && pos.row < rows && pos.col >= 0 && pos.col < cols && map[pos.row][pos.col] != '#';
+bool find_first_path_field(const Map& map, int row, std::size_t& field) {
+    for (int col = 0; col < map.cols; ++col) {
+        if (map[map.index(row, col)] == '.') {
+            field = map.index(row, col);
+            return true;
+        }
+    }
+    return false;
 }
 
-void collect_branch_positions(const Map& map, std::vector<Position>& vertices) {
-    auto rows = map.size();
-    auto cols = map[0].length();
-    for (int row = 0; row < rows; ++row) {
-        for (int col = 0; col < cols; ++col) {
-            if (map[row][col] == '#') {
+void collect_branch_positions(const Map& map, std::vector<std::size_t>& vertices) {
+    for (int row = 0; row < map.rows; ++row) {
+        for (auto index = map.index(row, 0); index <= map.index(row, map.cols - 1); ++index) {
+            if (map[index] == '#') {
                 continue;
             }
 
             int num_neighbors = 0;
-            for (int i_delta = 0; i_delta < 4; ++i_delta) {
-                int n_row = row + DR[i_delta];
-                int n_col = col + DC[i_delta];
-
-                if (is_legal_waypoint(map, Position(n_row, n_col))) {
-                    ++num_neighbors;
-                }
+            for (int direction = 0; direction < GRID_NEIGHBOURS; ++direction) {
+                num_neighbors += map[map.neighbour(index, direction)] != '#';
             }
 
             if (num_neighbors > 2) {
-                vertices.push_back(Position(row, col));
+                vertices.push_back(index);
             }
         }
     }
 }
 
-bool contains(const std::vector<Position>& positions, const Position& pos) {
-    for (const auto& current : positions) {
-        if (current == pos) {
-            return true;
-        }
-    }
-    return false;
+bool is_legal_delta(char field, int direction, bool is_part2) {
+    return field == SLOPES[direction] || field == '.' || is_part2;
 }
 
-std::vector<Position> get_legal_deltas(char field, bool is_part2) {
-    std::vector<Position> positions;
+Graph build_densed_graph(const Map& map, const std::vector<std::size_t>& vertices, bool is_part2) {
+    TRACE_SCOPE("build_densed_graph");
+    Graph graph;
 
-    if (field == '^' || field == '.' || is_part2) {
-        positions.push_back(Position(-1, 0));
-    }
-    if (field == 'v' || field == '.' || is_part2) {
-        positions.push_back(Position(1, 0));
+    std::vector<char> is_vertex(map.cells.size(), 0);
+    for (auto vertex : vertices) {
+        is_vertex[vertex] = 1;
     }
-    if (field == '<' || field == '.' || is_part2) {
-        positions.push_back(Position(0, -1));
-    }
-    if (field == '>' || field == '.' || is_part2) {
-        positions.push_back(Position(0, 1));
-    }
-
-    return positions;
-}
 
-Graph build_densed_graph(const Map& map, const std::vector<Position>& vertices, bool is_part2) {
-    Graph graph;
+    // A field is seen by the search of a vertex if its stamp is at least the one of the vertex, so the searches share
+    // one buffer without clearing it. Rock and the border count as seen by every search, the start and the end on the
+    // outer rows are walled in by the border.
+    std::vector<std::uint32_t> seen(map.cells.size(), 0);
+    for (std::size_t i = 0; i < map.cells.size(); ++i) {
+        seen[i] = map[i] == '#' ? UINT32_MAX : 0;
+    }
 
-    for (const auto& vertex : vertices) {
-        PositionSet seen;
-        std::vector<PositionState> stack;
+    std::uint32_t stamp = 0;
+    for (auto vertex : vertices) {
+        auto memory = get_scratch_arena().reset();
+        std::pmr::vector<FieldState> stack(memory);
         Edges edges;
 
-        seen.insert(vertex);
-        stack.push_back(PositionState(vertex.row, vertex.col, 0));
+        ++stamp;
+        seen[vertex] = stamp;
+        stack.push_back(FieldState(vertex, 0));
 
         while (stack.size() > 0) {
             auto current = stack.back();
             stack.pop_back();
+            TRACE_ADD("graph_expansions", 1);
 
-            if (current.steps != 0 && contains(vertices, current.pos)) {
-                edges.insert({current.pos, current.steps});
+            if (current.steps != 0 && is_vertex[current.index]) {
+                edges.insert({current.index, current.steps});
+                TRACE_ADD("edges", 1);
                 continue;
             }
 
-            for (const auto& delta : get_legal_deltas(map[current.pos.row][current.pos.col], is_part2)) {
-                int new_row = current.pos.row + delta.row;
-                int new_col = current.pos.col + delta.col;
-
-                Position next(new_row, new_col);
-                if (is_legal_waypoint(map, next) && !seen.count(next)) {
-                    stack.push_back(PositionState(new_row, new_col, current.steps + 1));
-                    seen.insert(next);
+            for (int direction = 0; direction < GRID_NEIGHBOURS; ++direction) {
+                auto next = map.neighbour(current.index, direction);
+                if (!is_legal_delta(map[current.index], direction, is_part2) || seen[next] >= stamp) {
+                    continue;
                 }
+
+                stack.push_back(FieldState(next, current.steps + 1));
+                seen[next] = stamp;
+                TRACE_MAX("max_stack", stack.size());
             }
         }
 
@@ -155,61 +234,540 @@ Graph build_densed_graph(const Map& map, const std::vector<Position>& vertices,
     return graph;
 }
 
-std::size_t find_longest_path_rec(const Graph& graph, const Position& current, PositionSet& seen, const Position& end,
-                                  bool& valid) {
-    if (current == end) {
+JunctionGraph build_junction_graph(const Graph& graph, const std::vector<std::size_t>& vertices, std::size_t start,
+                                   std::size_t end) {
+    std::unordered_map<std::size_t, int> ids;
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        ids[vertices[i]] = static_cast<int>(i);
+    }
+
+    JunctionGraph junctions;
+    junctions.edges.resize(vertices.size());
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        for (const auto& edge : graph.at(vertices[i])) {
+            junctions.edges[i].push_back({ids.at(edge.first), edge.second});
+        }
+    }
+    junctions.start = ids.at(start);
+    junctions.end = ids.at(end);
+    return junctions;
+}
+
+std::pair<int, int> get_undirected_edge(int a, int b) { return {std::min(a, b), std::max(a, b)}; }
+
+// Tarjan's biconnected components. The edges of the block that contains the virtual start to end edge are
+// kept, these are exactly the edges that lie on some simple path between start and end.
+void find_start_end_block(BlockSearch& search, int vertex, int parent) {
+    search.discovered[vertex] = search.low[vertex] = ++search.time;
+    for (auto neighbour : search.neighbours[vertex]) {
+        if (neighbour == parent) {
+            continue;
+        }
+
+        if (search.discovered[neighbour] == 0) {
+            search.edge_stack.push_back({vertex, neighbour});
+            find_start_end_block(search, neighbour, vertex);
+            search.low[vertex] = std::min(search.low[vertex], search.low[neighbour]);
+
+            if (search.low[neighbour] >= search.discovered[vertex]) {
+                std::vector<std::pair<int, int>> block;
+                std::pair<int, int> edge;
+                do {
+                    edge = search.edge_stack.back();
+                    search.edge_stack.pop_back();
+                    block.push_back(get_undirected_edge(edge.first, edge.second));
+                } while (edge != std::make_pair(vertex, neighbour));
+
+                if (std::find(block.begin(), block.end(), search.start_end) != block.end()) {
+                    search.kept.insert(block.begin(), block.end());
+                }
+            }
+        } else if (search.discovered[neighbour] < search.discovered[vertex]) {
+            search.edge_stack.push_back({vertex, neighbour});
+            search.low[vertex] = std::min(search.low[vertex], search.discovered[neighbour]);
+        }
+    }
+}
+
+// Removes the edges that can not be part of any simple path from start to end, returns true if any was removed
+bool prune_edges_off_paths(ReducibleGraph& graph) {
+    auto vertex_count = graph.out.size();
+    BlockSearch search;
+    search.neighbours.resize(vertex_count);
+    search.discovered.assign(vertex_count, 0);
+    search.low.assign(vertex_count, 0);
+    search.start_end = get_undirected_edge(graph.start, graph.end);
+
+    for (std::size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        search.neighbours[vertex] = graph.get_neighbours(static_cast<int>(vertex));
+    }
+    auto& start_neighbours = search.neighbours[graph.start];
+    if (std::find(start_neighbours.begin(), start_neighbours.end(), graph.end) == start_neighbours.end()) {
+        start_neighbours.push_back(graph.end);
+        search.neighbours[graph.end].push_back(graph.start);
+    }
+    find_start_end_block(search, graph.start, -1);
+
+    bool changed = false;
+    for (std::size_t from = 0; from < vertex_count; ++from) {
+        std::vector<int> pruned;
+        for (const auto& edge : graph.out[from]) {
+            if (!search.kept.count(get_undirected_edge(static_cast<int>(from), edge.first))) {
+                pruned.push_back(edge.first);
+            }
+        }
+        for (auto to : pruned) {
+            graph.remove_edge(static_cast<int>(from), to);
+            TRACE_ADD("pruned_edges", 1);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// A start with a single way out (an end with a single way in) is moved along that edge and its length becomes offset
+bool fold_corridors(ReducibleGraph& graph) {
+    bool changed = false;
+    while (graph.out[graph.start].size() == 1 && graph.out[graph.start].begin()->first != graph.end) {
+        auto edge = *graph.out[graph.start].begin();
+        graph.offset += edge.second;
+        graph.remove_vertex(graph.start);
+        graph.start = edge.first;
+        TRACE_ADD("folded", 1);
+        changed = true;
+    }
+    while (graph.in[graph.end].size() == 1 && graph.in[graph.end].begin()->first != graph.start) {
+        auto edge = *graph.in[graph.end].begin();
+        graph.offset += edge.second;
+        graph.remove_vertex(graph.end);
+        graph.end = edge.first;
+        TRACE_ADD("folded", 1);
+        changed = true;
+    }
+
+    // No path comes back to the start or leaves the end
+    for (auto from : graph.get_neighbours(graph.start)) {
+        graph.remove_edge(from, graph.start);
+    }
+    for (auto to : graph.get_neighbours(graph.end)) {
+        graph.remove_edge(graph.end, to);
+    }
+    return changed;
+}
+
+// Removes dead ends and replaces vertices with two neighbours by edges between these neighbours
+bool remove_simple_vertices(ReducibleGraph& graph) {
+    bool changed = false;
+    for (std::size_t i = 0; i < graph.out.size(); ++i) {
+        int vertex = static_cast<int>(i);
+        if (graph.removed[vertex] || vertex == graph.start || vertex == graph.end) {
+            continue;
+        }
+
+        auto neighbours = graph.get_neighbours(vertex);
+        if (neighbours.size() < 2 || graph.out[vertex].empty() || graph.in[vertex].empty()) {
+            graph.remove_vertex(vertex);
+            TRACE_ADD("dead_ends", 1);
+            changed = true;
+        } else if (neighbours.size() == 2) {
+            for (const auto& entry : graph.in[vertex]) {
+                for (const auto& exit : graph.out[vertex]) {
+                    if (entry.first != exit.first) {
+                        graph.add_edge(entry.first, exit.first, entry.second + exit.second);
+                    }
+                }
+            }
+            graph.remove_vertex(vertex);
+            TRACE_ADD("contracted", 1);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Shrinks the graph without changing the longest path from start to end, the remaining vertices are renumbered
+JunctionGraph reduce_junction_graph(const JunctionGraph& junctions) {
+    TRACE_SCOPE("reduce_junction_graph");
+    ReducibleGraph graph(junctions);
+
+    bool changed = true;
+    while (changed) {
+        changed = fold_corridors(graph);
+        changed |= remove_simple_vertices(graph);
+        changed |= prune_edges_off_paths(graph);
+    }
+
+    std::vector<int> ids(graph.out.size(), -1);
+    JunctionGraph reduced;
+    for (std::size_t vertex = 0; vertex < graph.out.size(); ++vertex) {
+        int id = static_cast<int>(vertex);
+        if (id == graph.start || id == graph.end || !graph.out[vertex].empty() || !graph.in[vertex].empty()) {
+            ids[vertex] = static_cast<int>(reduced.edges.size());
+            reduced.edges.emplace_back();
+        }
+    }
+    for (std::size_t from = 0; from < graph.out.size(); ++from) {
+        for (const auto& edge : graph.out[from]) {
+            reduced.edges[ids[from]].push_back({ids[edge.first], edge.second});
+        }
+    }
+    reduced.start = ids[graph.start];
+    reduced.end = ids[graph.end];
+    reduced.offset = graph.offset;
+    TRACE_ADD("vertices", reduced.edges.size());
+    return reduced;
+}
+
+std::size_t find_longest_path_rec(const JunctionGraph& graph, int current, std::pmr::vector<char>& seen,
+                                  std::size_t depth, bool& valid) {
+    TRACE_ADD("calls", 1);
+    TRACE_MAX("max_depth", depth);
+    if (current == graph.end) {
         valid = true;
         return 0;
     }
 
     std::size_t result = 0;
     valid = false;
-    for (const auto& edge : graph.at(current)) {
-        auto& cost = edge.second;
-        auto& target = edge.first;
-
-        if (seen.count(target)) {
+    for (const auto& edge : graph.edges[current]) {
+        if (seen[edge.target]) {
             continue;
         }
 
         bool target_valid = false;
-        seen.insert(target);
-        auto target_result = find_longest_path_rec(graph, target, seen, end, target_valid);
-        seen.erase(target);
+        seen[edge.target] = 1;
+        auto target_result = find_longest_path_rec(graph, edge.target, seen, depth + 1, target_valid);
+        seen[edge.target] = 0;
 
         if (target_valid) {
             valid = true;
-            result = std::max(result, cost + target_result);
+            result = std::max(result, edge.cost + target_result);
         }
     }
     return result;
 }
 
-std::size_t find_longest_path(const Graph& graph, const Position& start, const Position& end) {
-    PositionSet seen;
-    seen.insert(start);
+// Returns false if there is no path from the start to the end
+bool find_longest_path(const JunctionGraph& graph, std::size_t& length) {
+    TRACE_SCOPE("find_longest_path");
+    std::pmr::vector<char> seen(graph.edges.size(), 0, get_scratch_arena().reset());
+    seen[graph.start] = 1;
 
     bool valid = false;
-    auto result = find_longest_path_rec(graph, start, seen, end, valid);
-    assert(valid);
-    return result;
+    auto result = find_longest_path_rec(graph, graph.start, seen, 1, valid);
+    length = graph.offset + result;
+    return valid;
+}
+
+// Picks the layer of junctions at the same distance from the start (ignoring the edge directions) with the most even
+// sides that is small enough for the signatures. Every path from the start to the end crosses each layer between
+// them and no edge skips a layer, so the junctions before and after the layer form two sides without a common edge.
+// Returns an empty layer if there is none.
+SeparatorLayer find_separator_layer(const JunctionGraph& graph) {
+    TRACE_SCOPE("find_separator_layer");
+    auto vertex_count = graph.edges.size();
+    std::vector<std::vector<int>> neighbours(vertex_count);
+    for (std::size_t from = 0; from < vertex_count; ++from) {
+        for (const auto& edge : graph.edges[from]) {
+            neighbours[from].push_back(edge.target);
+            neighbours[edge.target].push_back(static_cast<int>(from));
+        }
+    }
+
+    std::vector<int> distances(vertex_count, -1);
+    std::vector<int> queue = {graph.start};
+    distances[graph.start] = 0;
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        for (auto neighbour : neighbours[queue[head]]) {
+            if (distances[neighbour] == -1) {
+                distances[neighbour] = distances[queue[head]] + 1;
+                queue.push_back(neighbour);
+            }
+        }
+    }
+
+    SeparatorLayer layer;
+    if (vertex_count > MAX_MITM_VERTICES || distances[graph.end] < 2) {
+        return layer;
+    }
+
+    std::vector<std::size_t> layer_sizes(distances[graph.end] + 1, 0);
+    for (auto distance : distances) {
+        if (distance != -1 && distance <= distances[graph.end]) {
+            ++layer_sizes[distance];
+        }
+    }
+
+    int best_distance = -1;
+    std::size_t best_side = vertex_count, before = 1;
+    for (int distance = 1; distance < distances[graph.end]; ++distance) {
+        auto after = queue.size() - before - layer_sizes[distance];
+        if (layer_sizes[distance] <= MAX_SEPARATOR_VERTICES && std::max(before, after) < best_side) {
+            best_distance = distance;
+            best_side = std::max(before, after);
+        }
+        before += layer_sizes[distance];
+    }
+    if (best_distance == -1) {
+        return layer;
+    }
+
+    layer.sides.assign(vertex_count, Side::NONE);
+    layer.indices.assign(vertex_count, -1);
+    for (std::size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        if (distances[vertex] == -1) {
+            continue;
+        } else if (distances[vertex] < best_distance) {
+            layer.sides[vertex] = Side::START;
+        } else if (distances[vertex] > best_distance) {
+            layer.sides[vertex] = Side::END;
+        } else {
+            layer.sides[vertex] = Side::LAYER;
+            layer.indices[vertex] = static_cast<int>(layer.vertices.size());
+            layer.vertices.push_back(static_cast<int>(vertex));
+        }
+    }
+    return layer;
+}
+
+std::uint64_t get_link_bits(int index, int target) { return std::uint64_t(target + 1) << (4 + 4 * index); }
+
+int get_link_target(std::uint64_t signature, int index) {
+    return static_cast<int>(signature >> (4 + 4 * index) & 15) - 1;
+}
+
+void keep_longest(SignatureLengths& lengths, std::uint64_t key, std::size_t length) {
+    auto [entry, is_new] = lengths.insert({key, length});
+    if (!is_new) {
+        entry->second = std::max(entry->second, length);
+    }
+}
+
+void add_links(SideSearch& search, std::size_t index, std::uint64_t visited, std::uint64_t linked,
+               std::uint64_t signature, std::size_t length);
+
+// Follows a link from the layer junction with the index through its side, the link ends at another layer junction
+// that is not yet linked to. Direct edges between layer junctions belong to the start side.
+void follow_link(SideSearch& search, std::size_t index, int current, std::uint64_t visited, std::uint64_t linked,
+                 std::uint64_t signature, std::size_t length) {
+    TRACE_ADD("side_steps", 1);
+    const auto& layer = search.layer;
+    for (const auto& edge : search.graph.edges[current]) {
+        auto side = layer.sides[edge.target];
+        if (side == search.side && !(visited & std::uint64_t(1) << edge.target)) {
+            follow_link(search, index, edge.target, visited | std::uint64_t(1) << edge.target, linked, signature,
+                        length + edge.cost);
+        } else if (side == Side::LAYER && edge.target != layer.vertices[index] &&
+                   (search.side == Side::START || layer.sides[current] == Side::END)) {
+            auto target = layer.indices[edge.target];
+            if (!(linked & std::uint64_t(1) << target)) {
+                add_links(search, index + 1, visited, linked | std::uint64_t(1) << target,
+                          signature | get_link_bits(static_cast<int>(index), target), length + edge.cost);
+            }
+        }
+    }
+}
+
+// Every layer junction from the index on gets at most one link through the side, in index order so that every set of
+// links is enumerated once. The junction where the end piece starts has no other way out.
+void add_links(SideSearch& search, std::size_t index, std::uint64_t visited, std::uint64_t linked,
+               std::uint64_t signature, std::size_t length) {
+    if (index == search.layer.vertices.size()) {
+        keep_longest(search.lengths, signature, length);
+        TRACE_ADD("signatures", 1);
+        return;
+    }
+
+    add_links(search, index + 1, visited, linked, signature, length);
+    auto vertex = search.layer.vertices[index];
+    if (search.side == Side::END && static_cast<std::size_t>(signature & 15) == index + 1) {
+        return;
+    }
+    follow_link(search, index, vertex, visited | std::uint64_t(1) << vertex, linked, signature, length);
+}
+
+// The start piece runs from the start through the start side to the first layer junction of the path
+void follow_start_piece(SideSearch& search, int current, std::uint64_t visited, std::size_t length) {
+    TRACE_ADD("side_steps", 1);
+    for (const auto& edge : search.graph.edges[current]) {
+        if (visited & std::uint64_t(1) << edge.target) {
+            continue;
+        }
+
+        if (search.layer.sides[edge.target] == Side::START) {
+            follow_start_piece(search, edge.target, visited | std::uint64_t(1) << edge.target, length + edge.cost);
+        } else if (search.layer.sides[edge.target] == Side::LAYER) {
+            auto first = search.layer.indices[edge.target];
+            add_links(search, 0, visited, std::uint64_t(1) << first, static_cast<std::uint64_t>(first + 1),
+                      length + edge.cost);
+        }
+    }
+}
+
+// The end piece runs from the last layer junction of the path through the end side to the end
+void follow_end_piece(SideSearch& search, int last, int current, std::uint64_t visited, std::size_t length) {
+    TRACE_ADD("side_steps", 1);
+    for (const auto& edge : search.graph.edges[current]) {
+        if (edge.target == search.graph.end) {
+            add_links(search, 0, visited, 0, static_cast<std::uint64_t>(search.layer.indices[last] + 1),
+                      length + edge.cost);
+        } else if (search.layer.sides[edge.target] == Side::END && !(visited & std::uint64_t(1) << edge.target)) {
+            follow_end_piece(search, last, edge.target, visited | std::uint64_t(1) << edge.target, length + edge.cost);
+        }
+    }
+}
+
+// Walks the layer junctions in the order of a path built from the links of one side. A junction with a link of the
+// side continues along it, any other junction either ends the path or continues through the other side to a junction
+// the side does not link to. The order is encoded with 5 bits per junction (index + 1 and the side of the piece that
+// leads to it) and keyed to the length of the side, the end side looks up the start side with the same order.
+void expand_order(OrderSearch& search, int index, std::uint64_t visited, std::size_t link_count, std::uint64_t order) {
+    TRACE_ADD("orders", 1);
+    bool is_end_side = search.side == Side::END;
+    auto append = [&](int next, bool is_end_piece) { return order << 5 | std::uint64_t(next + 1) << 1 | is_end_piece; };
+
+    auto target = get_link_target(search.signature, index);
+    if (target != -1) {
+        if (!(visited & std::uint64_t(1) << target)) {
+            expand_order(search, target, visited | std::uint64_t(1) << target, link_count + 1,
+                         append(target, is_end_side));
+        }
+        return;
+    }
+
+    if (link_count == search.link_count && (!is_end_side || index == search.anchor)) {
+        if (!is_end_side) {
+            keep_longest(search.start_lengths, order, search.length);
+        } else if (auto entry = search.start_lengths.find(order); entry != search.start_lengths.end()) {
+            search.is_valid = true;
+            search.result = std::max(search.result, entry->second + search.length);
+        }
+    }
+    if (is_end_side && index == search.anchor) {
+        return;
+    }
+
+    for (int next = 0; next < static_cast<int>(search.layer_size); ++next) {
+        if (!(visited & std::uint64_t(1) << next) && !(search.linked & std::uint64_t(1) << next) &&
+            (is_end_side || next != search.anchor)) {
+            expand_order(search, next, visited | std::uint64_t(1) << next, link_count, append(next, !is_end_side));
+        }
+    }
+}
+
+void expand_orders(OrderSearch& search, const SignatureLengths& lengths) {
+    for (const auto& [signature, length] : lengths) {
+        search.signature = signature;
+        search.length = length;
+        search.anchor = static_cast<int>(signature & 15) - 1;
+        search.linked = 0;
+        search.link_count = 0;
+        for (std::size_t index = 0; index < search.layer_size; ++index) {
+            auto target = get_link_target(signature, static_cast<int>(index));
+            if (target != -1) {
+                search.linked |= std::uint64_t(1) << target;
+                ++search.link_count;
+            }
+        }
+
+        if (search.side == Side::START) {
+            expand_order(search, search.anchor, std::uint64_t(1) << search.anchor, 0,
+                         static_cast<std::uint64_t>(search.anchor + 1) << 1);
+            continue;
+        }
+        for (int first = 0; first < static_cast<int>(search.layer_size); ++first) {
+            if (!(search.linked & std::uint64_t(1) << first)) {
+                expand_order(search, first, std::uint64_t(1) << first, 0, static_cast<std::uint64_t>(first + 1) << 1);
+            }
+        }
+    }
+}
+
+// Meet in the middle at a separator layer: a simple path from the start to the end visits some layer junctions
+// s1, ..., sj in this order. The piece before s1 lies on the start side, the one after sj on the end side and every
+// piece between two of them on one of the sides (or is a direct edge in the layer). Each side enumerates its vertex
+// disjoint sets of pieces once and keeps the longest per signature: the links between layer junctions and s1 (sj for
+// the end side). Pieces of different sides can not share a vertex, so it only remains to match the signatures that
+// fit together to one order of the layer junctions, which is done by expanding both into these orders.
+// Returns false if there is no path from the start to the end.
+bool find_longest_path_mitm(const JunctionGraph& graph, const SeparatorLayer& layer, std::size_t& length) {
+    TRACE_SCOPE("find_longest_path_mitm");
+    auto memory = get_scratch_arena().reset();
+    SignatureLengths start_side(memory), end_side(memory);
+
+    SideSearch start_search{graph, layer, Side::START, start_side};
+    follow_start_piece(start_search, graph.start, std::uint64_t(1) << graph.start, 0);
+    SideSearch end_search{graph, layer, Side::END, end_side};
+    for (auto last : layer.vertices) {
+        follow_end_piece(end_search, last, last, std::uint64_t(1) << last | std::uint64_t(1) << graph.end, 0);
+    }
+
+    SignatureLengths start_orders(memory);
+    OrderSearch order_search{Side::START, layer.vertices.size(), start_orders};
+    expand_orders(order_search, start_side);
+    order_search.side = Side::END;
+    expand_orders(order_search, end_side);
+
+    length = graph.offset + order_search.result;
+    return order_search.is_valid;
+}
+
+void* solver_parse(const char* input, std::size_t input_size) {
+    TRACE_SCOPE("parse");
+    auto maze = new Maze();
+    if (!try_read_padded_grid(input, input_size, '#', maze->map)) {
+        fprintf(stderr, "All rows of the maze need the same length\n");
+        delete maze;
+        return nullptr;
+    }
+    return maze;
 }
 
-int main(int argc, const char** argv) {
-    auto map = read_map(argv[1]);
-    Position start(0, find_first_path_field(map[0]));
-    Position end(map.size() - 1, find_first_path_field(map[map.size() - 1]));
+int solver_prepare(void* state) {
+    TRACE_SCOPE("prepare");
+    auto maze = static_cast<Maze*>(state);
+    const auto& map = maze->map;
+    if (!find_first_path_field(map, 0, maze->start) || !find_first_path_field(map, map.rows - 1, maze->end)) {
+        fprintf(stderr, "The first and the last row of the maze need a path field\n");
+        return 0;
+    }
 
-    std::vector<Position> vertices;
-    vertices.push_back(start);
-    vertices.push_back(end);
+    std::vector<std::size_t> vertices;
+    vertices.push_back(maze->start);
+    vertices.push_back(maze->end);
     collect_branch_positions(map, vertices);
 
     auto graph1 = build_densed_graph(map, vertices, false);
-    std::cout << "Part 1: " << find_longest_path(graph1, start, end) << "\n";
-
     auto graph2 = build_densed_graph(map, vertices, true);
-    std::cout << "Part 2: " << find_longest_path(graph2, start, end) << "\n";
+    maze->junctions1 = reduce_junction_graph(build_junction_graph(graph1, vertices, maze->start, maze->end));
+    maze->junctions2 = reduce_junction_graph(build_junction_graph(graph2, vertices, maze->start, maze->end));
+    maze->layer2 = find_separator_layer(maze->junctions2);
+    return 1;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    TRACE_SCOPE("solve");
+    const auto maze = static_cast<const Maze*>(state);
+
+    std::size_t part_1, part_2;
+    // Larger mazes do not fit the vertex masks or have no small separator layer, the exhaustive search is hopeless for
+    // them anyway
+    bool has_path = find_longest_path(maze->junctions1, part_1) &&
+                    (maze->layer2.vertices.empty() ? find_longest_path(maze->junctions2, part_2)
+                                                   : find_longest_path_mitm(maze->junctions2, maze->layer2, part_2));
+    if (!has_path) {
+        fprintf(stderr, "The maze has no path from the start to the end\n");
+        return 0;
+    }
+
+    answers->part_1 = part_1;
+    answers->part_2 = part_2;
+    answers->has_part_2 = 1;
+    return 1;
+}
+
+void solver_release(void* state) { delete static_cast<Maze*>(state); }
+
+const Solver DAY23_SOLVER = {"day23", 3, solver_parse, solver_prepare, solver_solve, solver_release};
 
-    return 0;
-}
\ No newline at end of file
+int main(int argc, const char** argv) { return solver_main(argc, argv, &DAY23_SOLVER); }
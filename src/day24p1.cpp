@@ -1,46 +1,99 @@
+#include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <iostream>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
+#include "parse.hpp"
+#include "server.h"
+#include "solver.h"
+
 #define EPS 1e-7
+#define BVH_LEAF_SIZE 4
+#define MAX_TIME_SLICES 256
 
 struct Vector2 {
     double x, y;
     Vector2() {}
     Vector2(double x, double y) : x(x), y(y) {}
-    Vector2(std::string text) {
-        auto first_comma = text.find_first_of(',');
-        auto last_comma = text.find_last_of(',');
 
-        this->x = std::stod(text.substr(0, first_comma));
-        this->y = std::stod(text.substr(first_comma + 1, last_comma - first_comma));
+    // Takes the next three numbers of text, z is not used in the plane. Returns false if text holds fewer.
+    bool take(std::string_view& text) {
+        double z;
+        return parse::try_take_number(text, x) && parse::try_take_number(text, y) && parse::try_take_number(text, z);
     }
 };
 
 struct Hailstone {
     Vector2 position, velocity;
-    Hailstone(std::string line) {
-        auto at_index = line.find('@');
-        auto position = line.substr(0, at_index);
-        auto velocity = line.substr(at_index + 1, line.length() - 1 - at_index);
+    Hailstone() {}
+
+    bool read(std::string_view line) { return position.take(line) && velocity.take(line); }
+};
+
+struct Vector3 {
+    double x, y, z;
+    Vector3() {}
+    Vector3(double x, double y, double z) : x(x), y(y), z(z) {}
+    Vector3(std::string_view& text) {
+        this->x = parse::take_number<double>(text);
+        this->y = parse::take_number<double>(text);
+        this->z = parse::take_number<double>(text);
+    }
+
+    double operator[](int axis) const { return axis == 0 ? x : axis == 1 ? y : z; }
+};
 
-        this->position = Vector2(position);
-        this->velocity = Vector2(velocity);
+struct Hailstone3 {
+    Vector3 position, velocity;
+    Hailstone3(std::string_view line) {
+        this->position = Vector3(line);
+        this->velocity = Vector3(line);
     }
+
+    Vector3 get_position(double time) const {
+        return Vector3(position.x + time * velocity.x, position.y + time * velocity.y, position.z + time * velocity.z);
+    }
+};
+
+struct Box {
+    double min[3], max[3];
+};
+
+struct BvhNode {
+    Box box;
+    std::size_t left, right;   // Children of inner nodes
+    std::size_t first, count;  // Item range of leaves, count is 0 for inner nodes
 };
 
-std::vector<Hailstone> read_hailstones(const char* filename) {
-    std::vector<Hailstone> stones;
-    std::ifstream file(filename);
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            stones.push_back(Hailstone(line));
+// Future crossings of all pairs of paths, answers the part 1 count for any test area. The crossings are sorted by their
+// larger coordinate, so an area only scans the crossings that do not exceed its upper bound.
+struct CrossingIndex {
+    std::size_t overlapping_paths = 0;  // Parallel pairs on one line, intersect counts them for every area
+    std::vector<double> max_coords, min_coords;
+};
+
+// Two hailstones that come within the threshold distance of each other, at the time of their closest approach
+struct Encounter {
+    std::size_t first, second;
+    double time, distance;
+};
+
+// Returns false for a malformed hailstone
+bool read_hailstones(const char* input, std::size_t input_size, std::vector<Hailstone>& stones) {
+    stones.reserve(input_size / 64);
+    parse::LineReader lines(input, input_size);
+    std::string_view line;
+    while (lines.next(line)) {
+        Hailstone stone;
+        if (!stone.read(line)) {
+            fprintf(stderr, "Malformed hailstone in line %zu\n", stones.size() + 1);
+            return false;
         }
-        file.close();
+        stones.push_back(stone);
     }
-    return stones;
+    return true;
 }
 
 double vec2_determinant(const Vector2& a, const Vector2& b) { return a.x * b.y - a.y * b.x; }
@@ -97,11 +150,266 @@ bool intersect(const Hailstone& a, const Hailstone& b, double lower, double uppe
     return lower <= point.x && point.x <= upper && lower <= point.y && point.y <= upper;
 }
 
-int main(int argc, const char** argv) {
-    auto stones = read_hailstones(argv[1]);
+CrossingIndex build_crossing_index(const std::vector<Hailstone>& stones) {
+    std::vector<std::pair<double, double>> crossings;
+    CrossingIndex index;
+    for (std::size_t i = 0; i + 1 < stones.size(); ++i) {
+        for (std::size_t j = i + 1; j < stones.size(); ++j) {
+            const auto& a = stones[i];
+            const auto& b = stones[j];
+            if (are_parallel(a.velocity, b.velocity)) {
+                index.overlapping_paths += is_on_line(a.position, a.velocity, b.position);
+                continue;
+            }
+
+            // Same crossing test as intersect without the area
+            auto p = intersection(a.position, a.velocity, b.position, b.velocity);
+            if (p.x < 0 || p.y < 0) {
+                continue;
+            }
+            Vector2 point(a.position.x + p.x * a.velocity.x, a.position.y + p.x * a.velocity.y);
+            crossings.emplace_back(std::max(point.x, point.y), std::min(point.x, point.y));
+        }
+    }
+
+    std::sort(crossings.begin(), crossings.end());
+    for (const auto& [max_coord, min_coord] : crossings) {
+        index.max_coords.push_back(max_coord);
+        index.min_coords.push_back(min_coord);
+    }
+    return index;
+}
+
+std::size_t count_crossings(const CrossingIndex& index, double lower, double upper) {
+    auto end = std::upper_bound(index.max_coords.begin(), index.max_coords.end(), upper) - index.max_coords.begin();
+    std::size_t count = index.overlapping_paths;
+    for (std::ptrdiff_t i = 0; i < end; ++i) {
+        count += index.min_coords[i] >= lower;
+    }
+    return count;
+}
+
+// Server query "<LOWER> <UPPER>", replies with the part 1 count for the test area [LOWER, UPPER]^2
+int handle_area_query(void* state, const char* query, char* reply, std::size_t reply_size) {
+    double lower, upper;
+    int length = 0;
+    if (sscanf(query, "%lf %lf%n", &lower, &upper, &length) != 2 || query[length] != '\0') {
+        return 0;
+    }
+
+    snprintf(reply, reply_size, "%zu", count_crossings(*static_cast<const CrossingIndex*>(state), lower, upper));
+    return 1;
+}
+
+std::vector<Hailstone3> read_hailstones_3d(const char* input, std::size_t input_size) {
+    std::vector<Hailstone3> stones;
+    stones.reserve(input_size / 64);
+    parse::LineReader lines(input, input_size);
+    std::string_view line;
+    while (lines.next(line)) {
+        stones.push_back(Hailstone3(line));
+    }
+    return stones;
+}
+
+bool overlaps(const Box& a, const Box& b) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (a.max[axis] < b.min[axis] || b.max[axis] < a.min[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Box get_union(const Box& a, const Box& b) {
+    Box box;
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min(a.min[axis], b.min[axis]);
+        box.max[axis] = std::max(a.max[axis], b.max[axis]);
+    }
+    return box;
+}
+
+// Box around the segment a hailstone sweeps between two times, grown by margin on every side
+Box get_swept_box(const Hailstone3& stone, double start_time, double end_time, double margin) {
+    auto start = stone.get_position(start_time);
+    auto end = stone.get_position(end_time);
+    Box box;
+    for (int axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min(start[axis], end[axis]) - margin;
+        box.max[axis] = std::max(start[axis], end[axis]) + margin;
+    }
+    return box;
+}
+
+// Splits the items at the median of the box centers along the axis in which the centers spread the most
+std::size_t build_bvh(std::vector<BvhNode>& nodes, const std::vector<Box>& boxes, std::vector<std::size_t>& items,
+                      std::size_t first, std::size_t count) {
+    auto node = nodes.size();
+    nodes.push_back(BvhNode{boxes[items[first]], 0, 0, first, count});
+    Box centers = {{INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+    for (auto i = first; i < first + count; ++i) {
+        const auto& box = boxes[items[i]];
+        nodes[node].box = get_union(nodes[node].box, box);
+        for (int axis = 0; axis < 3; ++axis) {
+            auto center = (box.min[axis] + box.max[axis]) / 2;
+            centers.min[axis] = std::min(centers.min[axis], center);
+            centers.max[axis] = std::max(centers.max[axis], center);
+        }
+    }
+    if (count <= BVH_LEAF_SIZE) {
+        return node;
+    }
+
+    int split_axis = 0;
+    for (int axis = 1; axis < 3; ++axis) {
+        if (centers.max[axis] - centers.min[axis] > centers.max[split_axis] - centers.min[split_axis]) {
+            split_axis = axis;
+        }
+    }
+    auto begin = items.begin() + first;
+    auto get_center = [&](std::size_t item) { return boxes[item].min[split_axis] + boxes[item].max[split_axis]; };
+    std::nth_element(begin, begin + count / 2, begin + count,
+                     [&](std::size_t a, std::size_t b) { return get_center(a) < get_center(b); });
+
+    auto left = build_bvh(nodes, boxes, items, first, count / 2);
+    auto right = build_bvh(nodes, boxes, items, first + count / 2, count - count / 2);
+    nodes[node].left = left;
+    nodes[node].right = right;
+    nodes[node].count = 0;
+    return node;
+}
+
+// Closest approach of two hailstones within [0, horizon]. The relative motion is solved in long double, the products
+// of the 15 digit positions and the velocities exceed what double represents exactly.
+Encounter get_closest_approach(const std::vector<Hailstone3>& stones, std::size_t first, std::size_t second,
+                               double horizon) {
+    const auto& a = stones[first];
+    const auto& b = stones[second];
+    long double delta[3], relative[3];
+    long double delta_dot_relative = 0, relative_dot_relative = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        delta[axis] = (long double)a.position[axis] - b.position[axis];
+        relative[axis] = (long double)a.velocity[axis] - b.velocity[axis];
+        delta_dot_relative += delta[axis] * relative[axis];
+        relative_dot_relative += relative[axis] * relative[axis];
+    }
+
+    long double time = relative_dot_relative > 0 ? -delta_dot_relative / relative_dot_relative : 0;
+    time = std::min<long double>(std::max<long double>(time, 0), horizon);
+    long double distance_squared = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        auto difference = delta[axis] + time * relative[axis];
+        distance_squared += difference * difference;
+    }
+    return {first, second, (double)time, (double)std::sqrt(distance_squared)};
+}
+
+bool is_earlier_encounter(const Encounter& lhs, const Encounter& rhs) {
+    if (lhs.time != rhs.time) {
+        return lhs.time < rhs.time;
+    }
+    return lhs.first != rhs.first ? lhs.first < rhs.first : lhs.second < rhs.second;
+}
+
+// Finds every pair of hailstones that comes within threshold of each other during [0, horizon].
+// The horizon is cut into time slices in which the fastest hailstone moves about the mean spacing of the starting
+// positions, so the swept boxes stay tight. Per slice a BVH over the swept boxes, grown by half the threshold, yields
+// the pairs whose boxes overlap, and only those candidates get the exact closest approach test.
+std::vector<Encounter> find_encounters(const std::vector<Hailstone3>& stones, double horizon, double threshold) {
+    std::vector<Encounter> encounters;
+    if (stones.size() < 2) {
+        return encounters;
+    }
+
+    auto start_bounds = get_swept_box(stones[0], 0, 0, 0);
+    double max_speed = 0;
+    for (const auto& stone : stones) {
+        start_bounds = get_union(start_bounds, get_swept_box(stone, 0, 0, 0));
+        const auto& v = stone.velocity;
+        max_speed = std::max(max_speed, std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z));
+    }
+    double extent = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        extent = std::max(extent, start_bounds.max[axis] - start_bounds.min[axis]);
+    }
+    auto spacing = std::max(threshold, extent / std::cbrt((double)stones.size()));
+    auto slices = spacing > 0 ? std::min(std::ceil(max_speed * horizon / spacing), (double)MAX_TIME_SLICES) : 1.0;
+    auto slice_count = std::max<std::size_t>((std::size_t)slices, 1);
+
+    std::unordered_set<std::uint64_t> candidates;
+    std::vector<Box> boxes(stones.size());
+    std::vector<std::size_t> items(stones.size());
+    std::vector<BvhNode> nodes;
+    std::vector<std::size_t> stack;
+    for (std::size_t slice = 0; slice < slice_count; ++slice) {
+        double start_time = horizon * slice / slice_count;
+        double end_time = horizon * (slice + 1) / slice_count;
+        for (std::size_t i = 0; i < stones.size(); ++i) {
+            boxes[i] = get_swept_box(stones[i], start_time, end_time, threshold / 2);
+            items[i] = i;
+        }
+        nodes.clear();
+        build_bvh(nodes, boxes, items, 0, stones.size());
+
+        for (std::size_t i = 0; i < stones.size(); ++i) {
+            stack.push_back(0);
+            while (!stack.empty()) {
+                const auto& node = nodes[stack.back()];
+                stack.pop_back();
+                if (!overlaps(node.box, boxes[i])) {
+                    continue;
+                }
+                if (node.count == 0) {
+                    stack.push_back(node.left);
+                    stack.push_back(node.right);
+                    continue;
+                }
+
+                for (auto item = node.first; item < node.first + node.count; ++item) {
+                    auto j = items[item];
+                    if (i < j && overlaps(boxes[i], boxes[j])) {
+                        candidates.insert((std::uint64_t)i << 32 | j);
+                    }
+                }
+            }
+        }
+    }
+
+    for (auto candidate : candidates) {
+        auto encounter = get_closest_approach(stones, candidate >> 32, candidate & 0xffffffff, horizon);
+        if (encounter.distance <= threshold) {
+            encounters.push_back(encounter);
+        }
+    }
+    std::sort(encounters.begin(), encounters.end(), is_earlier_encounter);
+    return encounters;
+}
+
+double parse_non_negative_or_panic(const char* text, const char* name) {
+    char* end;
+    double value = strtod(text, &end);
+    if (*text == '\0' || *end != '\0' || !(value >= 0)) {
+        fprintf(stderr, "Invalid %s '%s'\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+void* solver_parse(const char* input, std::size_t input_size) {
+    auto stones = new std::vector<Hailstone>();
+    if (!read_hailstones(input, input_size, *stones)) {
+        delete stones;
+        return nullptr;
+    }
+    return stones;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    const auto& stones = *static_cast<const std::vector<Hailstone>*>(state);
 
     std::size_t part_1 = 0;
-    for (std::size_t i = 0; i < stones.size() - 1; ++i) {
+    for (std::size_t i = 0; i + 1 < stones.size(); ++i) {
         for (std::size_t j = i + 1; j < stones.size(); ++j) {
             if (intersect(stones[i], stones[j], 200000000000000, 400000000000000)) {
                 ++part_1;
@@ -109,7 +417,45 @@ int main(int argc, const char** argv) {
         }
     }
 
-    std::cout << "Part 1: " << part_1 << "\n";
+    answers->part_1 = part_1;
+    return 1;
+}
 
-    return 0;
-}
\ No newline at end of file
+void solver_release(void* state) { delete static_cast<std::vector<Hailstone>*>(state); }
+
+const Solver DAY24_SOLVER = {"day24p1", 1, solver_parse, nullptr, solver_solve, solver_release};
+
+int main(int argc, const char** argv) {
+    if (argc == 5 && strcmp(argv[1], "--collisions") == 0) {  // Close encounters in space instead of crossing paths
+        double horizon = parse_non_negative_or_panic(argv[3], "time horizon");
+        double threshold = parse_non_negative_or_panic(argv[4], "distance threshold");
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        auto stones = read_hailstones_3d(input, input_size);
+        free(input);
+
+        auto encounters = find_encounters(stones, horizon, threshold);
+        for (const auto& encounter : encounters) {
+            printf("%zu %zu t=%.6f distance=%.6f\n", encounter.first + 1, encounter.second + 1, encounter.time,
+                   encounter.distance);
+        }
+        printf("Encounters: %zu\n", encounters.size());
+        exit(EXIT_SUCCESS);
+    }
+
+    if (argc == 4 && strcmp(argv[1], SERVE_FLAG) == 0) {  // Answer area queries on a socket from resident crossings
+        size_t input_size;
+        char* input = read_file_or_panic(argv[2], &input_size);
+        std::vector<Hailstone> stones;
+        if (!read_hailstones(input, input_size, stones)) {
+            exit(EXIT_FAILURE);
+        }
+        auto index = build_crossing_index(stones);
+        free(input);
+
+        serve_queries(argv[3], handle_area_query, &index);
+        exit(EXIT_SUCCESS);
+    }
+
+    return solver_main(argc, argv, &DAY24_SOLVER);
+}
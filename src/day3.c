@@ -1,24 +1,71 @@
+#define _GNU_SOURCE
 #include <ctype.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
-
-#include "common.h"
-
-typedef enum CollectStatus {
-    COLLECT_OK = 0,
-    COLLECT_NO_NUMBER,
-    COLLECT_LIMIT_EXCEEDED
-} CollectStatus;
+#include <string.h>
+
+#include "solver.h"
+
+#define DEFAULT_GEAR_PARTS 2
+#define NO_NUMBER_LABEL -1
+
+// Every digit cell knows the number it belongs to, so neighbors are looked up without walking back
+typedef struct NumberLabels {
+    int32_t* cell_labels;
+    int32_t* values;
+    size_t count;
+} NumberLabels;
+
+// One line of a streamed schematic, only three of them are kept in memory at once
+typedef struct SchematicRow {
+    char* cells;
+    uint64_t* symbol_mask;  // Horizontally dilated
+    int32_t* cell_labels;
+    int32_t* values;
+    int is_present;
+} SchematicRow;
+
+typedef struct Schematic {
+    const char* content;
+    size_t size;
+    size_t row_length;
+    size_t gear_parts;
+    uint64_t* symbol_mask;
+    NumberLabels labels;
+} Schematic;
 
 size_t get_row_length(const char* schematic);
 size_t get_index_at(size_t row, size_t column, size_t row_length);
 void get_position_from(size_t index, size_t row_length, size_t* row, size_t* column);
 int is_symbol(char item);
-int has_adjacent_symbol(const char* schematic, size_t schematic_size, size_t row_length, size_t index, size_t length);
-size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_length);
-int32_t get_serial_number_containing(const char* schematic, size_t index);
-CollectStatus collect_serial_number(int32_t* serial_numbers, const char* schematic, size_t index);
-size_t solve_part2(const char* schematic, size_t schematic_size, size_t row_length);
+size_t get_row_count(size_t schematic_size, size_t row_length);
+int has_uniform_rows(const char* schematic, size_t schematic_size, size_t row_length);
+size_t get_words_per_row(size_t row_length);
+void collect_row_symbols(const char* line, size_t row_length, uint64_t* row_symbols);
+void dilate_row_horizontally(const uint64_t* row_symbols, uint64_t* row_mask, size_t words_per_row);
+uint64_t* build_symbol_adjacency_mask(const char* schematic, size_t row_count, size_t row_length);
+int is_span_masked(const uint64_t* row_mask, size_t column, size_t length);
+size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_length, const uint64_t* mask);
+size_t label_digits(const char* cells, size_t size, int32_t* cell_labels, int32_t* values);
+NumberLabels label_serial_numbers(const char* schematic, size_t schematic_size);
+void free_number_labels(NumberLabels* labels);
+size_t collect_adjacent_labels(const NumberLabels* labels, size_t row_count, size_t row_length, size_t index,
+                               int32_t* adjacent);
+size_t solve_part2(const char* schematic, size_t schematic_size, size_t row_length, const NumberLabels* labels,
+                   size_t gear_parts);
+void init_schematic_row(SchematicRow* row, size_t row_length);
+void free_schematic_row(SchematicRow* row);
+void load_schematic_row(SchematicRow* row, const char* line, size_t row_length, uint64_t* symbols);
+void solve_window_row(SchematicRow* const* window, size_t row_length, size_t gear_parts, uint64_t* mask,
+                      size_t* result_1, size_t* result_2);
+void solve_streamed(FILE* file, size_t gear_parts, size_t* result_1, size_t* result_2);
+void* solver_parse(const char* input, size_t input_size);
+int solver_prepare(void* state);
+int solver_solve(void* state, SolverAnswers* answers);
+void solver_release(void* state);
+
+const Solver DAY3_SOLVER = {"day3", 1, solver_parse, solver_prepare, solver_solve, solver_release};
 
 size_t get_row_length(const char* schematic) {
     size_t index = 0;
@@ -41,32 +88,89 @@ void get_position_from(size_t index, size_t row_length, size_t* row, size_t* col
 
 int is_symbol(char item) { return !isdigit(item) && item != '.' && item != '\n' && item != '\0'; }
 
-int has_adjacent_symbol(const char* schematic, size_t schematic_size, size_t row_length, size_t index, size_t length) {
-    size_t row, column;
-    get_position_from(index, row_length, &row, &column);
+size_t get_row_count(size_t schematic_size, size_t row_length) {
+    size_t stride = row_length + 1;
+    return (schematic_size + row_length) / stride;  // The last row may miss its newline
+}
+
+int has_uniform_rows(const char* schematic, size_t schematic_size, size_t row_length) {
+    for (size_t row_start = 0; row_start < schematic_size; row_start += row_length + 1) {
+        if (get_row_length(&schematic[row_start]) != row_length) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
-    size_t row_start = row == 0 ? 0 : row - 1;
-    size_t row_end = row + 1;
-    size_t column_start = column == 0 ? 0 : column - 1;
-    size_t column_end = column + length;
+size_t get_words_per_row(size_t row_length) { return (row_length + 63) / 64; }
 
-    for (row = row_start; row <= row_end; ++row) {
-        for (column = column_start; column <= column_end; ++column) {
-            size_t index = get_index_at(row, column, row_length);
+void collect_row_symbols(const char* line, size_t row_length, uint64_t* row_symbols) {
+    for (size_t column = 0; column < row_length; ++column) {
+        row_symbols[column / 64] |= (uint64_t)is_symbol(line[column]) << (column % 64);
+    }
+}
 
-            if (index >= schematic_size) {
-                continue;
-            }
+void dilate_row_horizontally(const uint64_t* row_symbols, uint64_t* row_mask, size_t words_per_row) {
+    // Carry the bits that cross word boundaries
+    for (size_t word = 0; word < words_per_row; ++word) {
+        uint64_t left_carry = word > 0 ? row_symbols[word - 1] >> 63 : 0;
+        uint64_t right_carry = word + 1 < words_per_row ? row_symbols[word + 1] << 63 : 0;
+        row_mask[word] =
+            row_symbols[word] | (row_symbols[word] << 1) | left_carry | (row_symbols[word] >> 1) | right_carry;
+    }
+}
 
-            if (is_symbol(schematic[index])) {
-                return 1;
+uint64_t* build_symbol_adjacency_mask(const char* schematic, size_t row_count, size_t row_length) {
+    size_t words_per_row = get_words_per_row(row_length);
+    size_t mask_size = row_count * words_per_row;
+
+    uint64_t* symbols = (uint64_t*)calloc(mask_size, sizeof(uint64_t));
+    uint64_t* mask = (uint64_t*)calloc(mask_size, sizeof(uint64_t));
+    if (symbols == NULL || mask == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed for the symbol mask\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t row = 0; row < row_count; ++row) {
+        const char* line = &schematic[get_index_at(row, 0, row_length)];
+        collect_row_symbols(line, row_length, &symbols[row * words_per_row]);
+        dilate_row_horizontally(&symbols[row * words_per_row], &mask[row * words_per_row], words_per_row);
+    }
+
+    // Dilate vertically, the horizontal result is kept in symbols to read the unmodified neighbor rows
+    memcpy(symbols, mask, mask_size * sizeof(uint64_t));
+    for (size_t row = 0; row < row_count; ++row) {
+        uint64_t* row_mask = &mask[row * words_per_row];
+        for (size_t word = 0; word < words_per_row; ++word) {
+            if (row > 0) {
+                row_mask[word] |= symbols[(row - 1) * words_per_row + word];
+            }
+            if (row + 1 < row_count) {
+                row_mask[word] |= symbols[(row + 1) * words_per_row + word];
             }
         }
     }
+
+    free(symbols);
+    return mask;
+}
+
+int is_span_masked(const uint64_t* row_mask, size_t column, size_t length) {
+    size_t end = column + length;
+    for (size_t word = column / 64; word * 64 < end; ++word) {
+        size_t first = word * 64 > column ? 0 : column % 64;
+        size_t last = (word + 1) * 64 < end ? 64 : end - word * 64;
+        uint64_t span = (last == 64 ? ~(uint64_t)0 : ((uint64_t)1 << last) - 1) & (~(uint64_t)0 << first);
+        if (row_mask[word] & span) {
+            return 1;
+        }
+    }
     return 0;
 }
 
-size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_length) {
+size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_length, const uint64_t* mask) {
+    size_t words_per_row = get_words_per_row(row_length);
+
     size_t result = 0;
     for (size_t i = 0; i < schematic_size; ++i) {
         if (!isdigit(schematic[i])) {  // advance to next digit
@@ -79,8 +183,9 @@ size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_leng
         while (isdigit(schematic[++peek])) {
         }  // peek to end of serial number
 
-        size_t length_serial_number = peek - i;
-        if (has_adjacent_symbol(schematic, schematic_size, row_length, i, length_serial_number)) {
+        size_t row, column;
+        get_position_from(i, row_length, &row, &column);
+        if (is_span_masked(&mask[row * words_per_row], column, peek - i)) {
             result += serial_number;
         }
 
@@ -90,109 +195,339 @@ size_t solve_part1(const char* schematic, size_t schematic_size, size_t row_leng
     return result;
 }
 
-int32_t get_serial_number_containing(const char* schematic, size_t index) {
-    if (index == 0) {
-        return atoi(schematic);
+size_t label_digits(const char* cells, size_t size, int32_t* cell_labels, int32_t* values) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (!isdigit(cells[i])) {
+            cell_labels[i] = NO_NUMBER_LABEL;
+            continue;
+        }
+
+        if (i == 0 || !isdigit(cells[i - 1])) {  // First digit opens a new label
+            values[count++] = atoi(&cells[i]);
+        }
+        cell_labels[i] = count - 1;
     }
+    return count;
+}
 
-    if (!isdigit(schematic[index])) {
-        return atoi(&schematic[index + 1]);
+NumberLabels label_serial_numbers(const char* schematic, size_t schematic_size) {
+    NumberLabels labels = {0};
+    labels.cell_labels = (int32_t*)malloc(schematic_size * sizeof(int32_t));
+    labels.values = (int32_t*)malloc((schematic_size / 2 + 1) * sizeof(int32_t));  // Numbers need a separator
+    if (labels.cell_labels == NULL || labels.values == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed to label the serial numbers\n");
+        exit(EXIT_FAILURE);
     }
 
-    return get_serial_number_containing(schematic, index - 1);
+    labels.count = label_digits(schematic, schematic_size, labels.cell_labels, labels.values);
+    return labels;
 }
 
-CollectStatus collect_serial_number(int32_t* serial_numbers, const char* schematic, size_t index) {
-    if (!isdigit(schematic[index])) {
-        return COLLECT_NO_NUMBER;
-    }
+void free_number_labels(NumberLabels* labels) {
+    free(labels->cell_labels);
+    free(labels->values);
+    *labels = (NumberLabels){0};
+}
+
+size_t collect_adjacent_labels(const NumberLabels* labels, size_t row_count, size_t row_length, size_t index,
+                               int32_t* adjacent) {
+    size_t row, column;
+    get_position_from(index, row_length, &row, &column);
 
-    int32_t serial_number = get_serial_number_containing(schematic, index);
-    for (size_t i = 0; i < 2; ++i) {
-        if (serial_numbers[i] == 0) {
-            serial_numbers[i] = serial_number;
-            return COLLECT_OK;
+    size_t count = 0;
+    for (size_t n_row = row == 0 ? 0 : row - 1; n_row <= row + 1 && n_row < row_count; ++n_row) {
+        for (size_t n_column = column == 0 ? 0 : column - 1; n_column <= column + 1 && n_column < row_length;
+             ++n_column) {
+            int32_t label = labels->cell_labels[get_index_at(n_row, n_column, row_length)];
+            if (label == NO_NUMBER_LABEL) {
+                continue;
+            }
+
+            size_t i = 0;
+            while (i < count && adjacent[i] != label) {
+                ++i;
+            }
+            if (i == count) {
+                adjacent[count++] = label;
+            }
         }
     }
-
-    return COLLECT_LIMIT_EXCEEDED;
+    return count;
 }
 
-size_t solve_part2(const char* schematic, size_t schematic_size, size_t row_length) {
+size_t solve_part2(const char* schematic, size_t schematic_size, size_t row_length, const NumberLabels* labels,
+                   size_t gear_parts) {
+    size_t row_count = get_row_count(schematic_size, row_length);
+
     size_t result = 0;
     for (size_t i = 0; i < schematic_size; ++i) {
         if (schematic[i] != '*') {  // Advance to next asterix
             continue;
         }
 
-        size_t row, column;
-        get_position_from(i, row_length, &row, &column);
+        int32_t adjacent[8];
+        if (collect_adjacent_labels(labels, row_count, row_length, i, adjacent) != gear_parts) {
+            continue;
+        }
 
-        int32_t serial_numbers[2] = {0};
+        size_t gear_ratio = 1;
+        for (size_t part = 0; part < gear_parts; ++part) {
+            gear_ratio *= labels->values[adjacent[part]];
+        }
+        result += gear_ratio;
+    }
 
-        // Collect row above
-        if (row > 0) {
-            size_t index_above = get_index_at(row - 1, column, row_length);
-            if (collect_serial_number(serial_numbers, schematic, index_above)) {
-                // Collect top left
-                if (column > 0) {
-                    collect_serial_number(serial_numbers, schematic, index_above - 1);
-                }
-                collect_serial_number(serial_numbers, schematic, index_above + 1);  // top right
-            }
+    return result;
+}
+
+void init_schematic_row(SchematicRow* row, size_t row_length) {
+    row->cells = (char*)malloc(row_length + 1);
+    row->symbol_mask = (uint64_t*)malloc(get_words_per_row(row_length) * sizeof(uint64_t));
+    row->cell_labels = (int32_t*)malloc(row_length * sizeof(int32_t));
+    row->values = (int32_t*)malloc((row_length / 2 + 1) * sizeof(int32_t));
+    row->is_present = 0;
+    if (row->cells == NULL || row->symbol_mask == NULL || row->cell_labels == NULL || row->values == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed for the row window\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void free_schematic_row(SchematicRow* row) {
+    free(row->cells);
+    free(row->symbol_mask);
+    free(row->cell_labels);
+    free(row->values);
+}
+
+// The symbols buffer is scratch memory of one row of words
+void load_schematic_row(SchematicRow* row, const char* line, size_t row_length, uint64_t* symbols) {
+    size_t words_per_row = get_words_per_row(row_length);
+    memset(symbols, 0, words_per_row * sizeof(uint64_t));
+
+    memcpy(row->cells, line, row_length);
+    row->cells[row_length] = '\0';  // Terminates the atoi of numbers touching the right edge
+    collect_row_symbols(row->cells, row_length, symbols);
+    dilate_row_horizontally(symbols, row->symbol_mask, words_per_row);
+    label_digits(row->cells, row_length, row->cell_labels, row->values);
+    row->is_present = 1;
+}
+
+// The mask buffer is scratch memory of one row of words
+void solve_window_row(SchematicRow* const* window, size_t row_length, size_t gear_parts, uint64_t* mask,
+                      size_t* result_1, size_t* result_2) {
+    const SchematicRow* center = window[1];
+
+    size_t words_per_row = get_words_per_row(row_length);
+    memset(mask, 0, words_per_row * sizeof(uint64_t));
+    for (size_t w = 0; w < 3; ++w) {
+        for (size_t word = 0; window[w]->is_present && word < words_per_row; ++word) {
+            mask[word] |= window[w]->symbol_mask[word];
         }
+    }
 
-        // Collect in row
-        if (column > 0) {
-            if (collect_serial_number(serial_numbers, schematic, i - 1) == COLLECT_LIMIT_EXCEEDED) {
-                continue;
-            }
+    for (size_t column = 0; column < row_length; ++column) {
+        int32_t label = center->cell_labels[column];
+        if (label == NO_NUMBER_LABEL) {
+            continue;
         }
-        if (i + 1 < schematic_size) {
-            if (collect_serial_number(serial_numbers, schematic, i + 1) == COLLECT_LIMIT_EXCEEDED) {
-                continue;
-            }
+
+        size_t end = column;
+        while (end < row_length && center->cell_labels[end] == label) {
+            ++end;
+        }
+
+        if (is_span_masked(mask, column, end - column)) {
+            *result_1 += center->values[label];
+        }
+        column = end - 1;
+    }
+
+    for (size_t column = 0; column < row_length; ++column) {
+        if (center->cells[column] != '*') {
+            continue;
         }
 
-        // Collect row below
-        size_t index_below = get_index_at(row + 1, column, row_length);
-        if (index_below < schematic_size) {
-            switch (collect_serial_number(serial_numbers, schematic, index_below)) {
-                case COLLECT_LIMIT_EXCEEDED:
+        // Labels are only unique per row, so the window offset becomes part of the key
+        size_t adjacent[8];
+        size_t count = 0;
+        for (size_t w = 0; w < 3; ++w) {
+            for (size_t n_column = column == 0 ? 0 : column - 1;
+                 window[w]->is_present && n_column <= column + 1 && n_column < row_length; ++n_column) {
+                int32_t label = window[w]->cell_labels[n_column];
+                if (label == NO_NUMBER_LABEL) {
                     continue;
-                case COLLECT_NO_NUMBER:
-                    if (collect_serial_number(serial_numbers, schematic, index_below - 1) == COLLECT_LIMIT_EXCEEDED) {
-                        continue;
-                    }
-                    if (index_below + 1 < schematic_size) {
-                        if (collect_serial_number(serial_numbers, schematic, index_below + 1) == COLLECT_LIMIT_EXCEEDED) {
-                            continue;
-                        }
-                    }
+                }
+
+                size_t key = w * row_length + label;
+                size_t i = 0;
+                while (i < count && adjacent[i] != key) {
+                    ++i;
+                }
+                if (i == count) {
+                    adjacent[count++] = key;
+                }
             }
         }
 
-        if (serial_numbers[0] == 0 && serial_numbers[1] == 0) { // Not enough serial numbers found
+        if (count != gear_parts) {
             continue;
         }
 
-        result += serial_numbers[0] * serial_numbers[1];
+        size_t gear_ratio = 1;
+        for (size_t part = 0; part < count; ++part) {
+            gear_ratio *= window[adjacent[part] / row_length]->values[adjacent[part] % row_length];
+        }
+        *result_2 += gear_ratio;
     }
-    return result;
+}
+
+void solve_streamed(FILE* file, size_t gear_parts, size_t* result_1, size_t* result_2) {
+    *result_1 = 0;
+    *result_2 = 0;
+
+    size_t line_buffer_len = 0;
+    char* line = NULL;
+    ssize_t chars_read = getline(&line, &line_buffer_len, file);
+    if (chars_read == -1) {
+        free(line);
+        return;
+    }
+
+    size_t row_length = get_row_length(line);
+    SchematicRow rows[3];
+    for (size_t i = 0; i < 3; ++i) {
+        init_schematic_row(&rows[i], row_length);
+    }
+    uint64_t* row_words = (uint64_t*)malloc(get_words_per_row(row_length) * sizeof(uint64_t));
+    if (row_words == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed for the row window\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The window is {above, center, below}, rows leave it once their lower neighbor is known
+    SchematicRow* window[3] = {&rows[0], &rows[1], &rows[2]};
+    load_schematic_row(window[2], line, row_length, row_words);
+
+    while (window[2]->is_present) {
+        SchematicRow* recycled = window[0];
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = recycled;
+        window[2]->is_present = 0;
+
+        if ((chars_read = getline(&line, &line_buffer_len, file)) != -1 && get_row_length(line) > 0) {
+            if (get_row_length(line) != row_length) {
+                fprintf(stderr, "All rows of the schematic need a length of %zu\n", row_length);
+                exit(EXIT_FAILURE);
+            }
+            load_schematic_row(window[2], line, row_length, row_words);
+        }
+
+        solve_window_row(window, row_length, gear_parts, row_words, result_1, result_2);
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        free_schematic_row(&rows[i]);
+    }
+    free(row_words);
+    free(line);
+}
+
+void* solver_parse(const char* input, size_t input_size) {
+    size_t row_length = get_row_length(input);
+    if (!has_uniform_rows(input, input_size, row_length)) {
+        fprintf(stderr, "All rows of the schematic need a length of %zu\n", row_length);
+        return NULL;
+    }
+
+    Schematic* schematic = (Schematic*)calloc(1, sizeof(Schematic));
+    schematic->content = input;
+    schematic->size = input_size;
+    schematic->row_length = row_length;
+    schematic->gear_parts = DEFAULT_GEAR_PARTS;
+    return schematic;
+}
+
+int solver_prepare(void* state) {
+    Schematic* schematic = (Schematic*)state;
+    size_t row_count = get_row_count(schematic->size, schematic->row_length);
+    schematic->symbol_mask = build_symbol_adjacency_mask(schematic->content, row_count, schematic->row_length);
+    schematic->labels = label_serial_numbers(schematic->content, schematic->size);
+    return 1;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    const Schematic* schematic = (const Schematic*)state;
+    answers->part_1 = solve_part1(schematic->content, schematic->size, schematic->row_length, schematic->symbol_mask);
+    answers->part_2 = solve_part2(schematic->content, schematic->size, schematic->row_length, &schematic->labels,
+                                  schematic->gear_parts);
+    answers->has_part_2 = 1;
+    return 1;
+}
+
+void solver_release(void* state) {
+    Schematic* schematic = (Schematic*)state;
+    free(schematic->symbol_mask);
+    free_number_labels(&schematic->labels);
+    free(schematic);
 }
 
 int main(int argc, const char** argv) {
+    if (is_batch_invocation(argc, argv)) {
+        return solver_main(argc, argv, &DAY3_SOLVER);
+    }
+
+    int is_streamed = argc > 1 && strcmp(argv[1], "--stream") == 0;
+    if (is_streamed) {  // Process the schematic row by row, "-" reads it from stdin
+        --argc;
+        ++argv;
+    }
+
+    size_t gear_parts = DEFAULT_GEAR_PARTS;
+    if (argc > 2 && strcmp(argv[1], "--gears") == 0) {  // Optionally count gears with any other exact number of parts
+        gear_parts = strtoul(argv[2], NULL, 10);
+        if (gear_parts == 0 || gear_parts > 8) {
+            fprintf(stderr, "Invalid number of gear parts '%s', expected 1 to 8\n", argv[2]);
+            exit(EXIT_FAILURE);
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (is_streamed) {
+        FILE* file = argc == 2 && strcmp(argv[1], "-") == 0 ? stdin : open_input_file_or_panic(argc, argv);
+
+        size_t result_1, result_2;
+        solve_streamed(file, gear_parts, &result_1, &result_2);
+        printf("Part 1: %zu\n", result_1);
+        printf("Part 2: %zu\n", result_2);
+
+        fclose(file);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (gear_parts == DEFAULT_GEAR_PARTS) {
+        return solver_main(argc, argv, &DAY3_SOLVER);
+    }
+
     FILE* file = open_input_file_or_panic(argc, argv);
-    size_t schematic_size = 0;
-    char* schematic = read_content(file, &schematic_size);
-    size_t row_length = get_row_length(schematic);
+    size_t input_size = 0;
+    char* input = read_content(file, &input_size);
 
-    size_t result_1 = solve_part1(schematic, schematic_size, row_length);
-    printf("Part 1: %d\n", result_1);
-    size_t result_2 = solve_part2(schematic, schematic_size, row_length);
-    printf("Part 2: %d\n", result_2);
+    Schematic* schematic = (Schematic*)solver_parse(input, input_size);
+    if (schematic == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    schematic->gear_parts = gear_parts;
+    solver_prepare(schematic);
 
-    free(schematic);
+    SolverAnswers answers;
+    solver_solve(schematic, &answers);
+    print_answers(&answers);
+
+    solver_release(schematic);
+    free(input);
     fclose(file);
 
     exit(EXIT_SUCCESS);
@@ -1,109 +1,510 @@
 #define _GNU_SOURCE
-#include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "common.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define HAS_SSSE3_PARSER 1
+#endif
 
-#define MAX_NUMBER_IN_WINNING_MAP 100
-#define MAX_NUMBER_CARDS 202
+#include "solver.h"
 
-size_t find_matches_in_card(const char* card);
+#define INITIAL_LIST_CAPACITY 64
+#define FIXED_FIELD_WIDTH 3
+#define FIXED_FIELDS_PER_VECTOR 5
+
+typedef struct NumberList {
+    size_t size;
+    size_t capacity;
+    uint32_t* items;
+} NumberList;
+
+// Buffers reused for every card, the bitsets only grow to the largest number seen so far
+typedef struct CardScratch {
+    NumberList winning;
+    NumberList held;
+    size_t bitset_capacity;
+    uint64_t* winning_bits;
+    uint64_t* held_bits;
+} CardScratch;
+
+// Difference array of the copy counts for the upcoming cards, slot i % capacity belongs to card i.
+// The running sum only holds saturated counts of at most capacity cards, so it cannot overflow.
+typedef struct CopyRing {
+    size_t capacity;
+    __int128* differences;
+    __int128 running_copies;
+} CopyRing;
+
+// Running results over the cards seen so far
+typedef struct ScratchcardTally {
+    size_t card_index;
+    size_t points;
+    uint64_t cards;
+    CopyRing copies;
+} ScratchcardTally;
+
+// Column layout shared by all cards of the puzzle format: every number is a space and a right aligned two character
+// column, the winning numbers follow the colon and the held numbers follow " |". Cards in this layout are parsed
+// without scanning for digits, cards that do not fit it take the generic path.
+typedef struct CardLayout {
+    size_t colon;
+    size_t winning_count;
+    size_t held_count;
+    size_t line_length;  // Without the newline
+    int use_ssse3;
+} CardLayout;
+
+typedef struct Scratchcards {
+    size_t size;
+    size_t capacity;
+    size_t* matches;
+} Scratchcards;
+
+void* grow_or_panic(void* items, size_t* capacity, size_t required, size_t item_size);
+void push_number(NumberList* list, uint32_t number);
+uint32_t parse_number(const char* card, size_t* index);
+int parse_card(const char* card, NumberList* winning, NumberList* held);
+void fill_bitset(uint64_t* bits, size_t words, const NumberList* numbers);
+size_t count_common_bits(const uint64_t* lhs, const uint64_t* rhs, size_t words);
+int find_matches_in_card(const char* card, CardScratch* scratch, size_t* matches);
+int is_fixed_field(const char* field);
+size_t count_fixed_fields(const char* line, size_t* index, size_t line_length);
+int detect_card_layout(const char* line, CardLayout* layout);
+int read_fixed_fields(const char* fields, size_t count, uint64_t bits[2]);
+#ifdef HAS_SSSE3_PARSER
+int read_fixed_fields_ssse3(const char* fields, size_t count, size_t available, uint64_t bits[2]);
+#endif
+int find_matches_in_fixed_card(const char* card, size_t available, const CardLayout* layout, size_t* matches);
+void free_card_scratch(CardScratch* scratch);
+uint64_t saturating_add(uint64_t lhs, uint64_t rhs);
+void grow_copy_ring(CopyRing* ring, size_t card_index, size_t required);
+uint64_t take_card_count(CopyRing* ring, size_t card_index);
+void add_card_copies(CopyRing* ring, size_t card_index, size_t matches, uint64_t count);
 size_t get_point_value(size_t number_matches);
+void tally_card(ScratchcardTally* tally, size_t matches);
+void solve_streamed(FILE* file, ScratchcardTally* tally);
+void* solver_parse(const char* input, size_t input_size);
+int solver_solve(void* state, SolverAnswers* answers);
+void solver_release(void* state);
+
+const Solver DAY4_SOLVER = {"day4", 1, solver_parse, NULL, solver_solve, solver_release};
+
+void* grow_or_panic(void* items, size_t* capacity, size_t required, size_t item_size) {
+    if (required <= *capacity) {
+        return items;
+    }
+
+    size_t new_capacity = *capacity == 0 ? INITIAL_LIST_CAPACITY : *capacity;
+    while (new_capacity < required) {
+        new_capacity *= 2;
+    }
+
+    items = realloc(items, new_capacity * item_size);
+    if (items == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed to store %zu items\n", new_capacity);
+        exit(EXIT_FAILURE);
+    }
+    *capacity = new_capacity;
+    return items;
+}
+
+void push_number(NumberList* list, uint32_t number) {
+    list->items = (uint32_t*)grow_or_panic(list->items, &list->capacity, list->size + 1, sizeof(uint32_t));
+    list->items[list->size++] = number;
+}
+
+uint32_t parse_number(const char* card, size_t* index) {
+    uint32_t number = 0;
+    while (isdigit(card[*index])) {
+        number = number * 10 + (card[(*index)++] - '0');
+    }
+    return number;
+}
+
+// Returns 0 if the card has no colon before its numbers
+int parse_card(const char* card, NumberList* winning, NumberList* held) {
+    winning->size = 0;
+    held->size = 0;
 
-size_t find_matches_in_card(const char* card) {
     size_t index = 0;
     while (card[index] != ':') {
+        if (card[index] == '\n' || card[index] == '\0') {
+            return 0;
+        }
         ++index;  // advance to colon
     }
 
-    uint8_t winning_map[MAX_NUMBER_IN_WINNING_MAP] = {0};  // Use number to index into the map
-    while (card[index] != '|') {
-        while (!isdigit(card[index])) {
+    NumberList* current = winning;
+    while (card[index] != '\n' && card[index] != '\0') {
+        if (card[index] == '|') {
+            current = held;
+        }
+
+        if (isdigit(card[index])) {
+            push_number(current, parse_number(card, &index));
+        } else {
             ++index;
         }
+    }
+    return 1;
+}
 
-        size_t winning_number = atoi(&card[index]);
-        assert(winning_number < MAX_NUMBER_IN_WINNING_MAP && "Increase the MAX_NUMBER_IN_WINNING_MAP");
-        winning_map[winning_number] = 1;
+void fill_bitset(uint64_t* bits, size_t words, const NumberList* numbers) {
+    memset(bits, 0, words * sizeof(uint64_t));
+    for (size_t i = 0; i < numbers->size; ++i) {
+        bits[numbers->items[i] / 64] |= (uint64_t)1 << (numbers->items[i] % 64);
+    }
+}
 
-        while (isdigit(card[index])) {
-            ++index;  // advance to first non digit char
+size_t count_common_bits(const uint64_t* lhs, const uint64_t* rhs, size_t words) {
+    // Plain loop over whole words, vectorizes for wide number ranges
+    size_t result = 0;
+    for (size_t i = 0; i < words; ++i) {
+        result += __builtin_popcountll(lhs[i] & rhs[i]);
+    }
+    return result;
+}
+
+// Returns 0 for a malformed card
+int find_matches_in_card(const char* card, CardScratch* scratch, size_t* matches) {
+    if (!parse_card(card, &scratch->winning, &scratch->held)) {
+        return 0;
+    }
+
+    uint32_t max_number = 0;
+    for (size_t i = 0; i < scratch->winning.size; ++i) {
+        max_number = scratch->winning.items[i] > max_number ? scratch->winning.items[i] : max_number;
+    }
+    for (size_t i = 0; i < scratch->held.size; ++i) {
+        max_number = scratch->held.items[i] > max_number ? scratch->held.items[i] : max_number;
+    }
+
+    size_t words = max_number / 64 + 1;
+    if (words > scratch->bitset_capacity) {
+        size_t capacity = scratch->bitset_capacity;
+        scratch->winning_bits = (uint64_t*)grow_or_panic(scratch->winning_bits, &capacity, words, sizeof(uint64_t));
+        scratch->held_bits =
+            (uint64_t*)grow_or_panic(scratch->held_bits, &scratch->bitset_capacity, words, sizeof(uint64_t));
+    }
+
+    fill_bitset(scratch->winning_bits, words, &scratch->winning);
+    fill_bitset(scratch->held_bits, words, &scratch->held);
+    *matches = count_common_bits(scratch->winning_bits, scratch->held_bits, words);
+    return 1;
+}
+
+int is_fixed_field(const char* field) {
+    return field[0] == ' ' && (isdigit(field[1]) || field[1] == ' ') && isdigit(field[2]);
+}
+
+size_t count_fixed_fields(const char* line, size_t* index, size_t line_length) {
+    size_t count = 0;
+    while (*index + FIXED_FIELD_WIDTH <= line_length && is_fixed_field(&line[*index])) {
+        *index += FIXED_FIELD_WIDTH;
+        ++count;
+    }
+    return count;
+}
+
+// Returns 1 if the line is a card in the fixed column layout and fills the layout from it
+int detect_card_layout(const char* line, CardLayout* layout) {
+    size_t line_length = strcspn(line, "\n");
+    const char* colon = (const char*)memchr(line, ':', line_length);
+    if (colon == NULL) {
+        return 0;
+    }
+
+    layout->colon = (size_t)(colon - line);
+    layout->line_length = line_length;
+    size_t index = layout->colon + 1;
+    layout->winning_count = count_fixed_fields(line, &index, line_length);
+    if (index + 2 > line_length || line[index] != ' ' || line[index + 1] != '|') {
+        return 0;
+    }
+    index += 2;
+    layout->held_count = count_fixed_fields(line, &index, line_length);
+
+#ifdef HAS_SSSE3_PARSER
+    layout->use_ssse3 = __builtin_cpu_supports("ssse3");
+#else
+    layout->use_ssse3 = 0;
+#endif
+    return index == line_length && layout->winning_count > 0 && layout->held_count > 0;
+}
+
+// Sets the bits of the numbers in count consecutive fields, returns 0 if a field is malformed
+int read_fixed_fields(const char* fields, size_t count, uint64_t bits[2]) {
+    for (size_t i = 0; i < count; ++i) {
+        const char* field = &fields[i * FIXED_FIELD_WIDTH];
+        if (!is_fixed_field(field)) {
+            return 0;
         }
-        ++index;  // skip one space so the pipe will be at index on end or a digit one the next number
+        uint32_t number = (field[1] == ' ' ? 0 : (uint32_t)(field[1] - '0') * 10) + (uint32_t)(field[2] - '0');
+        bits[number / 64] |= (uint64_t)1 << (number % 64);
     }
+    return 1;
+}
 
-    size_t number_matches = 0;
-    while (card[index] != '\n' && card[index] != '\0') {
-        while (!isdigit(card[index])) {
-            ++index;
+#ifdef HAS_SSSE3_PARSER
+// Same as read_fixed_fields for five fields per 16 byte load, available is the number of readable bytes from fields.
+// The shuffle gathers the tens and units digits of the numbers pairwise into lanes 0-9 and the separating spaces into
+// lanes 10-14. The saturating subtraction turns the digits into values and a leading space into 0, then the
+// multiply-add combines every digit pair into one 16 bit number.
+__attribute__((target("ssse3"))) int read_fixed_fields_ssse3(const char* fields, size_t count, size_t available,
+                                                              uint64_t bits[2]) {
+    const __m128i gather = _mm_setr_epi8(1, 2, 4, 5, 7, 8, 10, 11, 13, 14, 0, 3, 6, 9, 12, -1);
+    const __m128i weights = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0, 0, 0);
+    const int tens_lanes = 0x155;
+    const int units_lanes = 0x2aa;
+
+    for (size_t first = 0; first < count; first += FIXED_FIELDS_PER_VECTOR) {
+        size_t fields_in_vector = count - first < FIXED_FIELDS_PER_VECTOR ? count - first : FIXED_FIELDS_PER_VECTOR;
+        const char* text = &fields[first * FIXED_FIELD_WIDTH];
+        __m128i bytes;
+        if (first * FIXED_FIELD_WIDTH + sizeof(__m128i) <= available) {
+            bytes = _mm_loadu_si128((const __m128i*)text);
+        } else {
+            char tail[sizeof(__m128i)] = {0};  // The last fields of the input, a full load could leave the buffer
+            memcpy(tail, text, fields_in_vector * FIXED_FIELD_WIDTH);
+            bytes = _mm_loadu_si128((const __m128i*)tail);
         }
 
-        size_t found_number = atoi(&card[index]);
-        assert(found_number < MAX_NUMBER_IN_WINNING_MAP && "Increase the MAX_NUMBER_IN_WINNING_MAP");
-        if (winning_map[found_number]) {
-            ++number_matches;
+        __m128i lanes = _mm_shuffle_epi8(bytes, gather);
+        __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(lanes, _mm_set1_epi8('0' - 1)),
+                                         _mm_cmplt_epi8(lanes, _mm_set1_epi8('9' + 1)));
+        int digits = _mm_movemask_epi8(is_digit);
+        int spaces = _mm_movemask_epi8(_mm_cmpeq_epi8(lanes, _mm_set1_epi8(' ')));
+        int number_lanes = (1 << (2 * fields_in_vector)) - 1;
+        int separator_lanes = ((1 << fields_in_vector) - 1) << 10;
+        if ((digits & units_lanes & number_lanes) != (units_lanes & number_lanes) ||
+            ((digits | spaces) & tens_lanes & number_lanes) != (tens_lanes & number_lanes) ||
+            (spaces & separator_lanes) != separator_lanes) {
+            return 0;
         }
 
-        while (isdigit(card[index])) {
-            ++index;
+        __m128i numbers = _mm_maddubs_epi16(_mm_subs_epu8(lanes, _mm_set1_epi8('0')), weights);
+        uint16_t values[8];
+        _mm_storeu_si128((__m128i*)values, numbers);
+        for (size_t i = 0; i < fields_in_vector; ++i) {
+            bits[values[i] / 64] |= (uint64_t)1 << (values[i] % 64);
         }
     }
+    return 1;
+}
+#endif
+
+// Returns 1 and the number of matches if the card fits the layout, available is the number of readable bytes from card
+int find_matches_in_fixed_card(const char* card, size_t available, const CardLayout* layout, size_t* matches) {
+    size_t held_start = layout->colon + 1 + layout->winning_count * FIXED_FIELD_WIDTH + 2;
+    if (available <= layout->line_length || card[layout->colon] != ':' || card[held_start - 1] != '|' ||
+        (card[layout->line_length] != '\n' && card[layout->line_length] != '\0') ||
+        memchr(card, '\n', layout->colon) != NULL) {
+        return 0;
+    }
+
+    // All numbers of the layout are below 128, so two words hold a bitset
+    uint64_t winning[2] = {0, 0};
+    uint64_t held[2] = {0, 0};
+    const char* winning_fields = &card[layout->colon + 1];
+    const char* held_fields = &card[held_start];
+    int is_valid;
+#ifdef HAS_SSSE3_PARSER
+    if (layout->use_ssse3) {
+        is_valid =
+            read_fixed_fields_ssse3(winning_fields, layout->winning_count, available - layout->colon - 1, winning) &&
+            read_fixed_fields_ssse3(held_fields, layout->held_count, available - held_start, held);
+    } else
+#endif
+    {
+        is_valid = read_fixed_fields(winning_fields, layout->winning_count, winning) &&
+                   read_fixed_fields(held_fields, layout->held_count, held);
+    }
+
+    *matches = (size_t)(__builtin_popcountll(winning[0] & held[0]) + __builtin_popcountll(winning[1] & held[1]));
+    return is_valid;
+}
 
-    return number_matches;
+void free_card_scratch(CardScratch* scratch) {
+    free(scratch->winning.items);
+    free(scratch->held.items);
+    free(scratch->winning_bits);
+    free(scratch->held_bits);
 }
 
+uint64_t saturating_add(uint64_t lhs, uint64_t rhs) {
+    uint64_t result;
+    return __builtin_add_overflow(lhs, rhs, &result) ? UINT64_MAX : result;
+}
+
+void grow_copy_ring(CopyRing* ring, size_t card_index, size_t required) {
+    if (required <= ring->capacity) {
+        return;
+    }
+
+    size_t capacity = ring->capacity == 0 ? INITIAL_LIST_CAPACITY : ring->capacity;
+    while (capacity < required) {
+        capacity *= 2;
+    }
+
+    __int128* differences = (__int128*)calloc(capacity, sizeof(__int128));
+    if (differences == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed to track %zu card copies\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t offset = 0; offset < ring->capacity; ++offset) {  // Keep pending cards at their new slots
+        differences[(card_index + offset) % capacity] = ring->differences[(card_index + offset) % ring->capacity];
+    }
+
+    free(ring->differences);
+    ring->differences = differences;
+    ring->capacity = capacity;
+}
+
+uint64_t take_card_count(CopyRing* ring, size_t card_index) {
+    if (ring->capacity > 0) {
+        size_t slot = card_index % ring->capacity;
+        ring->running_copies += ring->differences[slot];
+        ring->differences[slot] = 0;
+    }
+
+    __int128 count = ring->running_copies + 1;  // Original card
+    return count > UINT64_MAX ? UINT64_MAX : (uint64_t)count;
+}
+
+void add_card_copies(CopyRing* ring, size_t card_index, size_t matches, uint64_t count) {
+    if (matches == 0) {
+        return;
+    }
+
+    grow_copy_ring(ring, card_index, matches + 1);  // The slot of the current card is free again
+    ring->differences[(card_index + 1) % ring->capacity] += count;
+    ring->differences[(card_index + matches + 1) % ring->capacity] -= count;
+}
+
+// 2^(matches - 1), saturated once the value no longer fits
 size_t get_point_value(size_t number_matches) {
-    if (number_matches < 2) {
-        return number_matches;
+    if (number_matches == 0) {
+        return 0;
+    }
+    if (number_matches > sizeof(size_t) * CHAR_BIT) {
+        return SIZE_MAX;
     }
 
-    return 2 * get_point_value(number_matches - 1);
+    return (size_t)1 << (number_matches - 1);
 }
 
-int main(int argc, const char** argv) {
-    FILE* file = open_input_file_or_panic(argc, argv);
+void tally_card(ScratchcardTally* tally, size_t matches) {
+    uint64_t card_count = take_card_count(&tally->copies, tally->card_index);
+    tally->cards = saturating_add(tally->cards, card_count);
+    tally->points = saturating_add(tally->points, get_point_value(matches));
 
-    size_t result_1 = 0;
-    int get_copies = 1;
-    uint32_t card_count[MAX_NUMBER_CARDS] = {0};
+    add_card_copies(&tally->copies, tally->card_index, matches, card_count);
+    ++tally->card_index;
+}
+
+void solve_streamed(FILE* file, ScratchcardTally* tally) {
+    CardScratch scratch = {0};
+
+    CardLayout layout;
+    int is_fixed = -1;  // Detected on the first line
 
     size_t line_buffer_len = 0;
     char* line = NULL;
-    ssize_t chars_read;
-    size_t line_index;
-    for (line_index = 0; (chars_read = getline(&line, &line_buffer_len, file)) != -1; ++line_index) {
-        assert(line_index < MAX_NUMBER_CARDS && "Increase MAX_NUMBER_CARDS");
+    ssize_t line_length;
+    while ((line_length = getline(&line, &line_buffer_len, file)) != -1) {
+        if (is_fixed < 0) {
+            is_fixed = detect_card_layout(line, &layout);
+        }
+
+        size_t matches;
+        if ((!is_fixed || !find_matches_in_fixed_card(line, (size_t)line_length + 1, &layout, &matches)) &&
+            !find_matches_in_card(line, &scratch, &matches)) {
+            fprintf(stderr, "Missing colon in card %zu\n", tally->card_index + 1);
+            exit(EXIT_FAILURE);
+        }
+        tally_card(tally, matches);
+    }
 
-        card_count[line_index]++;  // Original card
+    if (line != NULL) {
+        free(line);
+    }
+    free_card_scratch(&scratch);
+}
 
-        size_t found_matches = find_matches_in_card(line);
-        result_1 += get_point_value(found_matches);
+void* solver_parse(const char* input, size_t input_size) {
+    Scratchcards* cards = (Scratchcards*)calloc(1, sizeof(Scratchcards));
+    CardScratch scratch = {0};
+    CardLayout layout;
+    int is_fixed = detect_card_layout(input, &layout);
 
-        if (!get_copies) {
+    size_t line_start = 0;
+    while (line_start < input_size) {
+        const char* line = &input[line_start];
+        cards->matches = (size_t*)grow_or_panic(cards->matches, &cards->capacity, cards->size + 1, sizeof(size_t));
+
+        // The input is NUL terminated, so one byte more than the rest of the input is readable
+        size_t matches;
+        if (is_fixed && find_matches_in_fixed_card(line, input_size - line_start + 1, &layout, &matches)) {
+            cards->matches[cards->size++] = matches;
+            line_start += layout.line_length + 1;
             continue;
         }
-
-        assert((line_index + found_matches) < MAX_NUMBER_CARDS && "Increase MAX_NUMBER_CARDS");
-        for (size_t copied_card_offset = 1; copied_card_offset <= found_matches; ++copied_card_offset) {
-            card_count[line_index + copied_card_offset] += card_count[line_index];
+        if (!find_matches_in_card(line, &scratch, &matches)) {
+            fprintf(stderr, "Missing colon in card %zu\n", cards->size + 1);
+            free_card_scratch(&scratch);
+            free(cards->matches);
+            free(cards);
+            return NULL;
         }
-    }
+        cards->matches[cards->size++] = matches;
 
-    size_t result_2 = 0;
-    for (size_t i = 0; i < line_index; ++i) {
-        result_2 += card_count[i];
+        const char* line_end = strchr(line, '\n');
+        line_start = line_end == NULL ? input_size : (size_t)(line_end - input) + 1;
     }
 
-    if (line != NULL) {
-        free(line);
+    free_card_scratch(&scratch);
+    return cards;
+}
+
+int solver_solve(void* state, SolverAnswers* answers) {
+    const Scratchcards* cards = (const Scratchcards*)state;
+
+    ScratchcardTally tally = {0};
+    for (size_t i = 0; i < cards->size; ++i) {
+        tally_card(&tally, cards->matches[i]);
     }
-    fclose(file);
+    free(tally.copies.differences);
+
+    answers->part_1 = tally.points;
+    answers->part_2 = tally.cards;
+    answers->has_part_2 = 1;
+    return 1;
+}
 
-    printf("Part 1: %d\n", result_1);
-    printf("Part 2: %d\n", result_2);
+void solver_release(void* state) {
+    free(((Scratchcards*)state)->matches);
+    free(state);
+}
+
+int main(int argc, const char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0) {  // Card by card in O(max matches) memory, "-" is stdin
+        FILE* file = argc == 3 && strcmp(argv[2], "-") == 0 ? stdin : open_input_file_or_panic(argc - 1, argv + 1);
+
+        ScratchcardTally tally = {0};
+        solve_streamed(file, &tally);
+        free(tally.copies.differences);
+        fclose(file);
 
-    exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+        printf("Part 1: %zu\n", tally.points);
+        printf("Part 2: %llu\n", (unsigned long long)tally.cards);
+        exit(EXIT_SUCCESS);
+    }
+
+    return solver_main(argc, argv, &DAY4_SOLVER);
+}
@@ -0,0 +1,76 @@
+#ifndef GRID_HPP_
+#define GRID_HPP_
+
+// Flat character grid for the map puzzles with a one-cell border of rock around the input.
+// Cells are addressed by a linear index into one row-major buffer and neighbours are reached by adding one of the
+// precomputed offsets, the border guarantees that every neighbour of an input cell exists, so searches need no
+// bounds checks as long as they never step onto a border cell.
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "parse.hpp"
+
+#define GRID_NEIGHBOURS 4
+
+struct PaddedGrid {
+    std::string cells;
+    int rows = 0, cols = 0;
+    std::ptrdiff_t stride = 0;
+    // up, down, left, right
+    std::ptrdiff_t neighbour_offsets[GRID_NEIGHBOURS] = {};
+
+    std::size_t index(int row, int col) const { return static_cast<std::size_t>((row + 1) * stride + col + 1); }
+
+    int get_row(std::size_t index) const { return static_cast<int>(index / stride) - 1; }
+
+    int get_col(std::size_t index) const { return static_cast<int>(index % stride) - 1; }
+
+    char operator[](std::size_t index) const { return cells[index]; }
+
+    std::size_t neighbour(std::size_t index, int direction) const { return index + neighbour_offsets[direction]; }
+};
+
+// Returns false if the rows of the input differ in length
+inline bool try_read_padded_grid(const char* input, std::size_t input_size, char border, PaddedGrid& grid) {
+    grid = PaddedGrid();
+    parse::LineReader lines(input, input_size);
+    std::string_view line;
+
+    if (!lines.next(line)) {
+        return true;
+    }
+
+    grid.cols = static_cast<int>(line.size());
+    grid.stride = grid.cols + 2;
+    grid.neighbour_offsets[0] = -grid.stride;
+    grid.neighbour_offsets[1] = grid.stride;
+    grid.neighbour_offsets[2] = -1;
+    grid.neighbour_offsets[3] = 1;
+
+    grid.cells.reserve(input_size + 4 * grid.stride);
+    grid.cells.append(grid.stride, border);
+    do {
+        if (static_cast<int>(line.size()) != grid.cols) {
+            return false;
+        }
+        grid.cells.push_back(border);
+        grid.cells.append(line);
+        grid.cells.push_back(border);
+        ++grid.rows;
+    } while (lines.next(line));
+    grid.cells.append(grid.stride, border);
+
+    return true;
+}
+
+inline PaddedGrid read_padded_grid(const char* input, std::size_t input_size, char border) {
+    PaddedGrid grid;
+    [[maybe_unused]] bool is_rectangular = try_read_padded_grid(input, input_size, border, grid);
+    assert(is_rectangular);
+    return grid;
+}
+
+#endif // GRID_HPP_
@@ -0,0 +1,58 @@
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+// Minimal fork/join loop for independent work items of the C++ solvers.
+// The items are handed out one at a time from a shared counter, so callers should order them largest first.
+// $AOC_THREADS limits the number of threads, by default every hardware thread is used. Threads that already run next
+// to each other (the batch workers) set a smaller thread budget, which bounds the loops they start.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Most threads a parallel loop of the calling thread may use, 0 means unbounded
+inline thread_local std::size_t thread_budget = 0;
+
+inline void set_thread_budget(std::size_t budget) { thread_budget = budget; }
+
+inline std::size_t get_thread_count() {
+    std::size_t count = std::max(1u, std::thread::hardware_concurrency());
+    const char* text = std::getenv("AOC_THREADS");
+    if (text != nullptr && std::atoi(text) > 0) {
+        count = static_cast<std::size_t>(std::atoi(text));
+    }
+    return thread_budget > 0 ? std::min(count, thread_budget) : count;
+}
+
+// Calls work(i) for every i in [0, count), work has to be safe to call concurrently for different items
+template <typename Work>
+void parallel_for(std::size_t count, Work work) {
+    auto thread_count = std::min(get_thread_count(), count);
+    if (thread_count <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            work(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next_item{0};
+    auto run_worker = [&]() {
+        for (auto i = next_item++; i < count; i = next_item++) {
+            work(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(run_worker);
+    }
+    run_worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif // PARALLEL_HPP_
@@ -0,0 +1,70 @@
+#ifndef PARSE_HPP_
+#define PARSE_HPP_
+
+// Zero-copy parsing of the puzzle input for the C++ solvers.
+// Lines are string_views into the input buffer and numbers are read with std::from_chars, so parsing a record
+// neither copies nor allocates.
+
+#include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <system_error>
+
+namespace parse {
+
+class LineReader {
+   public:
+    LineReader(const char* input, std::size_t input_size) : rest(input, input_size) {}
+
+    bool next(std::string_view& line) {
+        if (rest.empty()) {
+            return false;
+        }
+
+        auto line_end = rest.find('\n');
+        if (line_end == std::string_view::npos) {
+            line = rest;
+            rest = std::string_view();
+        } else {
+            line = rest.substr(0, line_end);
+            rest.remove_prefix(line_end + 1);
+        }
+        return true;
+    }
+
+   private:
+    std::string_view rest;
+};
+
+inline bool is_number_start(char c) { return (c >= '0' && c <= '9') || c == '-'; }
+
+// Skips the separators in front of the next number in text, parses it and removes both from text.
+// Returns false and leaves text unchanged if no number in range follows.
+template <typename T>
+bool try_take_number(std::string_view& text, T& value) {
+    std::size_t number_start = 0;
+    while (number_start < text.size() && !is_number_start(text[number_start])) {
+        ++number_start;
+    }
+
+    auto result = std::from_chars(text.data() + number_start, text.data() + text.size(), value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    text.remove_prefix(result.ptr - text.data());
+    return true;
+}
+
+// Same as try_take_number for input that is known to hold the number.
+template <typename T>
+T take_number(std::string_view& text) {
+    T value{};
+    [[maybe_unused]] bool is_number = try_take_number(text, value);
+    assert(is_number);
+    return value;
+}
+
+} // namespace parse
+
+#endif // PARSE_HPP_
@@ -0,0 +1,183 @@
+#ifndef PERF_H_
+#define PERF_H_
+
+// Optional hardware performance counters per solver phase, built on perf_event_open.
+// Without AOC_PERF all hooks expand to nothing.
+
+#ifdef AOC_PERF
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PERF_MAX_PHASES 8
+
+typedef enum PerfEvent {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+static const char* const PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                               "branch_misses"};
+
+// All counters form one group with cycles as the leader, so they are scheduled together and describe the same
+// instructions. The group is inherited by the threads the solver starts after the first phase (the parallel loops),
+// their counts are added once they have been joined. If the PMU has to multiplex the group, the counts are scaled by
+// the time the group was enabled over the time it actually ran.
+typedef struct PerfSession {
+    int is_open;
+    int leader_fd;                // -1 if the cycles can not be counted, no other event is counted then either
+    int slots[PERF_EVENT_COUNT];  // Position in the group read, -1 if the event is not supported or not permitted
+    size_t slot_count;
+    uint64_t phase_begin[3 + PERF_EVENT_COUNT];
+    uint64_t totals[PERF_MAX_PHASES][PERF_EVENT_COUNT];
+    uint64_t runs[PERF_MAX_PHASES];
+} PerfSession;
+
+static PerfSession perf_session;
+
+static inline int perf_open_event(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = group_fd == -1;  // Members follow the leader
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static inline void perf_open_member(PerfEvent event, uint32_t type, uint64_t config) {
+    perf_session.slots[event] = -1;
+    if (perf_session.leader_fd != -1 && perf_open_event(type, config, perf_session.leader_fd) != -1) {
+        perf_session.slots[event] = (int)perf_session.slot_count++;
+    }
+}
+
+static inline void perf_open(void) {
+    perf_session.leader_fd = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    perf_session.slot_count = 0;
+    perf_session.slots[PERF_CYCLES] = -1;
+    if (perf_session.leader_fd != -1) {
+        perf_session.slots[PERF_CYCLES] = (int)perf_session.slot_count++;
+    }
+
+    perf_open_member(PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf_open_member(PERF_L1D_MISSES, PERF_TYPE_HW_CACHE,
+                     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    perf_open_member(PERF_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    perf_open_member(PERF_BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    perf_session.is_open = 1;
+}
+
+// Reads {nr, time enabled, time running, value per slot} of the group including the joined threads
+static inline int perf_read_group(uint64_t* values) {
+    size_t size = (3 + perf_session.slot_count) * sizeof(uint64_t);
+    return read(perf_session.leader_fd, values, size) == (ssize_t)size;
+}
+
+static inline void perf_phase_begin(void) {
+    if (!perf_session.is_open) {
+        perf_open();
+    }
+
+    // Inherited counts can not be reset, so every phase counts the difference of two group reads
+    if (perf_session.leader_fd != -1 && perf_read_group(perf_session.phase_begin)) {
+        ioctl(perf_session.leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static inline void perf_phase_end(size_t phase) {
+    if (perf_session.leader_fd == -1) {
+        return;
+    }
+    ioctl(perf_session.leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    uint64_t values[3 + PERF_EVENT_COUNT];
+    if (!perf_read_group(values)) {
+        return;
+    }
+    uint64_t enabled = values[1] - perf_session.phase_begin[1];
+    uint64_t running = values[2] - perf_session.phase_begin[2];
+    if (running == 0) {  // The group was never scheduled, the phase has no counts
+        return;
+    }
+
+    for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+        int slot = perf_session.slots[event];
+        if (slot != -1) {
+            uint64_t count = values[3 + slot] - perf_session.phase_begin[3 + slot];
+            perf_session.totals[phase][event] += (uint64_t)((double)count * enabled / running);
+        }
+    }
+    ++perf_session.runs[phase];
+}
+
+static inline void perf_reset(void) {
+    memset(perf_session.totals, 0, sizeof(perf_session.totals));
+    memset(perf_session.runs, 0, sizeof(perf_session.runs));
+}
+
+// Averages per run of every phase, unavailable events are reported as null
+static inline void perf_write_json(FILE* output, const char* const* phase_names, size_t phase_count) {
+    fprintf(output, "{");
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        fprintf(output, "%s\"%s\": {", phase > 0 ? ", " : "", phase_names[phase]);
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            fprintf(output, "%s\"%s\": ", event > 0 ? ", " : "", PERF_EVENT_NAMES[event]);
+            if (perf_session.slots[event] == -1 || perf_session.runs[phase] == 0) {
+                fprintf(output, "null");
+            } else {
+                fprintf(output, "%llu",
+                        (unsigned long long)(perf_session.totals[phase][event] / perf_session.runs[phase]));
+            }
+        }
+        fprintf(output, "}");
+    }
+    fprintf(output, "}");
+}
+
+static inline void perf_report(FILE* output, const char* const* phase_names, size_t phase_count) {
+    for (size_t phase = 0; phase < phase_count; ++phase) {
+        fprintf(output, "%-8s", phase_names[phase]);
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            if (perf_session.slots[event] == -1 || perf_session.runs[phase] == 0) {
+                fprintf(output, " %s n/a", PERF_EVENT_NAMES[event]);
+            } else {
+                fprintf(output, " %s %llu", PERF_EVENT_NAMES[event],
+                        (unsigned long long)(perf_session.totals[phase][event] / perf_session.runs[phase]));
+            }
+        }
+        fprintf(output, "\n");
+    }
+}
+
+#define PERF_PHASE_BEGIN() perf_phase_begin()
+#define PERF_PHASE_END(phase) perf_phase_end(phase)
+#define PERF_RESET() perf_reset()
+#define PERF_WRITE_JSON(output, phase_names, phase_count) perf_write_json(output, phase_names, phase_count)
+#define PERF_REPORT(output, phase_names, phase_count) perf_report(output, phase_names, phase_count)
+
+#else
+
+#define PERF_PHASE_BEGIN()
+#define PERF_PHASE_END(phase)
+#define PERF_RESET()
+#define PERF_WRITE_JSON(output, phase_names, phase_count)
+#define PERF_REPORT(output, phase_names, phase_count)
+
+#endif
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+// Resident query server for solvers that answer a parameterised question about a fixed input.
+// The solver loads and preprocesses its input once, serve_queries then listens on a Unix domain socket and answers a
+// line protocol: every non-empty request line gets exactly one reply line in request order, so clients may pipeline.
+// "stats" replies with the latency statistics of the answered queries, "quit" closes the connection after the pending
+// replies and "shutdown" stops the server. Every other line goes to the solver's handler, malformed queries are
+// answered with "error ...".
+// Latencies cover parsing a query and formatting its reply on the server, they are kept in a log-linear histogram, so
+// the reported percentiles are upper bounds within 1/2^LATENCY_SUB_BUCKET_BITS of the exact value.
+// All clients are served from a single poll loop on one thread, so handlers do not have to be thread safe.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "solver.h"
+
+#define SERVE_FLAG "--serve"
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_MAX_LINE 4096
+#define SERVER_MAX_REPLY 256
+#define SERVER_BACKLOG 16
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_BUCKETS (64 << LATENCY_SUB_BUCKET_BITS)
+
+// Writes the answer to a query line, without a newline, into reply. Returns 0 if the query is malformed.
+typedef int (*QueryHandler)(void* state, const char* query, char* reply, size_t reply_size);
+
+typedef struct LatencyStats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyStats;
+
+typedef struct ServerClient {
+    int fd;
+    int is_discarding;  // The current line is longer than SERVER_MAX_LINE and skipped up to its newline
+    int is_closing;     // Close once the pending replies are sent
+    size_t input_size;
+    char input[SERVER_MAX_LINE];
+    char* output;
+    size_t output_size;
+    size_t output_sent;
+    size_t output_capacity;
+} ServerClient;
+
+typedef struct Server {
+    QueryHandler handler;
+    void* state;
+    int is_running;
+    LatencyStats stats;
+} Server;
+
+static volatile sig_atomic_t is_server_interrupted = 0;
+
+static void interrupt_server(int signal_number) {
+    (void)signal_number;
+    is_server_interrupted = 1;
+}
+
+static size_t get_latency_bucket(uint64_t ns) {
+    if (ns < (1u << LATENCY_SUB_BUCKET_BITS)) {
+        return (size_t)ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BUCKET_BITS;
+    return ((size_t)(shift + 1) << LATENCY_SUB_BUCKET_BITS) +
+           (size_t)((ns >> shift) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+// Largest latency that falls into the bucket
+static uint64_t get_latency_bucket_limit(size_t bucket) {
+    if (bucket < (1u << LATENCY_SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    int shift = (int)(bucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+    uint64_t mantissa = (bucket & ((1u << LATENCY_SUB_BUCKET_BITS) - 1)) | (1u << LATENCY_SUB_BUCKET_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static void record_latency(LatencyStats* stats, uint64_t ns) {
+    ++stats->count;
+    stats->total_ns += ns;
+    stats->max_ns = ns > stats->max_ns ? ns : stats->max_ns;
+    ++stats->buckets[get_latency_bucket(ns)];
+}
+
+static uint64_t get_latency_percentile(const LatencyStats* stats, unsigned percent) {
+    uint64_t rank = (stats->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += stats->buckets[bucket];
+        if (seen >= rank && seen > 0) {
+            uint64_t limit = get_latency_bucket_limit(bucket);
+            return limit < stats->max_ns ? limit : stats->max_ns;
+        }
+    }
+    return 0;
+}
+
+static void format_latency_stats(const LatencyStats* stats, char* text, size_t text_size) {
+    snprintf(text, text_size, "queries=%llu mean_us=%.3f p50_us=%.3f p90_us=%.3f p99_us=%.3f max_us=%.3f",
+             (unsigned long long)stats->count, stats->count == 0 ? 0.0 : stats->total_ns / 1e3 / stats->count,
+             get_latency_percentile(stats, 50) / 1e3, get_latency_percentile(stats, 90) / 1e3,
+             get_latency_percentile(stats, 99) / 1e3, stats->max_ns / 1e3);
+}
+
+static void append_reply(ServerClient* client, const char* reply) {
+    size_t length = strlen(reply);
+    if (client->output_size + length + 1 > client->output_capacity) {
+        size_t capacity = client->output_capacity == 0 ? SERVER_MAX_LINE : client->output_capacity;
+        while (client->output_size + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(client->output, capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Unable to aquire memory needed to buffer the replies\n");
+            exit(EXIT_FAILURE);
+        }
+        client->output = grown;
+        client->output_capacity = capacity;
+    }
+
+    memcpy(client->output + client->output_size, reply, length);
+    client->output[client->output_size + length] = '\n';
+    client->output_size += length + 1;
+}
+
+static void handle_request(Server* server, ServerClient* client, char* line) {
+    size_t length = strlen(line);
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t')) {
+        line[--length] = '\0';
+    }
+    while (*line == ' ' || *line == '\t') {
+        ++line;
+    }
+    if (*line == '\0') {
+        return;
+    }
+
+    char reply[SERVER_MAX_REPLY];
+    if (strcmp(line, "stats") == 0) {
+        format_latency_stats(&server->stats, reply, SERVER_MAX_REPLY);
+    } else if (strcmp(line, "quit") == 0) {
+        client->is_closing = 1;
+        return;
+    } else if (strcmp(line, "shutdown") == 0) {
+        server->is_running = 0;
+        snprintf(reply, SERVER_MAX_REPLY, "ok");
+    } else {
+        uint64_t start = get_time_ns();
+        int is_valid = server->handler(server->state, line, reply, SERVER_MAX_REPLY);
+        record_latency(&server->stats, get_time_ns() - start);
+        if (!is_valid) {
+            snprintf(reply, SERVER_MAX_REPLY, "error invalid query '%.64s'", line);
+        }
+    }
+    append_reply(client, reply);
+}
+
+// Answers every complete line of the input buffer and keeps the incomplete rest
+static void handle_client_input(Server* server, ServerClient* client) {
+    size_t line_start = 0;
+    for (size_t i = 0; i < client->input_size && !client->is_closing; ++i) {
+        if (client->input[i] != '\n') {
+            continue;
+        }
+
+        client->input[i] = '\0';
+        if (!client->is_discarding) {
+            handle_request(server, client, client->input + line_start);
+        }
+        client->is_discarding = 0;
+        line_start = i + 1;
+    }
+
+    client->input_size -= line_start;
+    memmove(client->input, client->input + line_start, client->input_size);
+    if (client->input_size == SERVER_MAX_LINE) {
+        if (!client->is_discarding) {
+            append_reply(client, "error line too long");
+        }
+        client->is_discarding = 1;
+        client->input_size = 0;
+    }
+}
+
+static void read_client(Server* server, ServerClient* client) {
+    ssize_t count = read(client->fd, client->input + client->input_size, SERVER_MAX_LINE - client->input_size);
+    if (count < 0) {
+        client->is_closing = errno != EAGAIN && errno != EINTR;
+        return;
+    }
+
+    client->input_size += (size_t)count;
+    if (count == 0) {
+        client->input[client->input_size++] = '\n';  // Answer a last line without newline before closing
+    }
+    handle_client_input(server, client);
+    client->is_closing |= count == 0;
+}
+
+static void write_client(ServerClient* client) {
+    while (client->output_sent < client->output_size) {
+        size_t pending = client->output_size - client->output_sent;
+        ssize_t count = send(client->fd, client->output + client->output_sent, pending, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                client->output_sent = client->output_size = 0;  // The client is gone, drop its replies
+                client->is_closing = 1;
+            }
+            return;
+        }
+        client->output_sent += (size_t)count;
+    }
+    client->output_sent = client->output_size = 0;
+}
+
+static int open_server_socket_or_panic(const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path '%s' is too long\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, socket_path);
+
+    struct stat status;
+    if (stat(socket_path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(socket_path);  // Left behind by a server that did not shut down
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "Unable to listen on '%s': %s\n", socket_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+static void close_client(ServerClient** clients, size_t* client_count, size_t i) {
+    close(clients[i]->fd);
+    free(clients[i]->output);
+    free(clients[i]);
+    clients[i] = clients[--(*client_count)];
+}
+
+// Serves queries on the socket until a client sends "shutdown" or the process receives SIGINT or SIGTERM
+static void serve_queries(const char* socket_path, QueryHandler handler, void* state) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.handler = handler;
+    server.state = state;
+    server.is_running = 1;
+    int listen_fd = open_server_socket_or_panic(socket_path);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = interrupt_server;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    fprintf(stderr, "Serving queries on '%s'\n", socket_path);
+
+    ServerClient* clients[SERVER_MAX_CLIENTS];
+    size_t client_count = 0;
+    struct pollfd polls[SERVER_MAX_CLIENTS + 1];
+    while (server.is_running && !is_server_interrupted) {
+        polls[0].fd = listen_fd;
+        polls[0].events = POLLIN;
+        for (size_t i = 0; i < client_count; ++i) {
+            // A client that does not read its replies is not read from either, so its buffer stays bounded
+            polls[i + 1].fd = clients[i]->fd;
+            polls[i + 1].events = clients[i]->output_size > 0 ? POLLOUT : POLLIN;
+        }
+        if (poll(polls, client_count + 1, -1) < 0) {
+            continue;  // Interrupted by a signal
+        }
+
+        for (size_t i = client_count; i-- > 0;) {
+            ServerClient* client = clients[i];
+            if (polls[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_client(&server, client);
+            }
+            write_client(client);
+            if (client->is_closing && client->output_size == 0) {
+                close_client(clients, &client_count, i);
+            }
+        }
+
+        if (polls[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0 && client_count == SERVER_MAX_CLIENTS) {
+                close(fd);
+            } else if (fd >= 0) {
+                ServerClient* client = (ServerClient*)calloc(1, sizeof(ServerClient));
+                if (client == NULL) {
+                    fprintf(stderr, "Unable to aquire memory needed to accept a client\n");
+                    exit(EXIT_FAILURE);
+                }
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                client->fd = fd;
+                clients[client_count++] = client;
+            }
+        }
+    }
+
+    while (client_count > 0) {
+        write_client(clients[client_count - 1]);  // Best effort for the reply to "shutdown"
+        close_client(clients, &client_count, client_count - 1);
+    }
+    close(listen_fd);
+    unlink(socket_path);
+
+    char text[SERVER_MAX_REPLY];
+    format_latency_stats(&server.stats, text, SERVER_MAX_REPLY);
+    fprintf(stderr, "%s\n", text);
+}
+
+#endif
@@ -0,0 +1,504 @@
+#ifndef SOLVER_H_
+#define SOLVER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alloc_stats.h"
+#include "cache.h"
+#include "common.h"
+#include "perf.h"
+
+#ifdef __cplusplus
+#include "parallel.hpp"
+#endif
+
+#define DEFAULT_BENCH_REPETITIONS 100
+#define DEFAULT_BENCH_WARMUP 5
+
+#define BATCH_FLAG "--batch"
+#define MAX_BATCH_THREADS 256
+
+typedef struct SolverAnswers {
+    uint64_t part_1;
+    uint64_t part_2;
+    int has_part_2;
+} SolverAnswers;
+
+// Common entry point of every solver. The input is NUL terminated and has to outlive the parsed state.
+// prepare may be NULL for solvers without work between parsing and solving. An invalid input is reported on stderr
+// and signaled by parse returning NULL or prepare/solve returning 0, release is still called for a parsed state.
+// version has to be increased whenever a change can alter the answers, it invalidates the cached results of the solver.
+typedef struct Solver {
+    const char* name;
+    unsigned version;
+    void* (*parse)(const char* input, size_t input_size);
+    int (*prepare)(void* state);
+    int (*solve)(void* state, SolverAnswers* answers);
+    void (*release)(void* state);
+} Solver;
+
+typedef enum SolverPhase { PHASE_PARSE = 0, PHASE_PREPARE, PHASE_SOLVE, PHASE_COUNT } SolverPhase;
+
+static const char* const SOLVER_PHASE_NAMES[PHASE_COUNT] = {"parse", "prepare", "solve"};
+
+static uint64_t get_time_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static char* read_file_or_panic(const char* filename, size_t* size) {
+    FILE* file = open_file_or_panic(filename);
+    char* content = read_content(file, size);
+    fclose(file);
+    return content;
+}
+
+// Runs all phases of the solver, phase_ns receives the wall time of each phase if it is not NULL. Returns 0 if the
+// solver rejected the input.
+static int run_solver(const Solver* solver, const char* input, size_t input_size, SolverAnswers* answers,
+                      uint64_t* phase_ns) {
+    uint64_t times[PHASE_COUNT + 1];
+    memset(answers, 0, sizeof(SolverAnswers));
+
+    times[PHASE_PARSE] = get_time_ns();
+    ALLOC_PHASE_BEGIN();
+    PERF_PHASE_BEGIN();
+    void* state = solver->parse(input, input_size);
+    PERF_PHASE_END(PHASE_PARSE);
+    ALLOC_PHASE_END(PHASE_PARSE);
+    if (state == NULL) {
+        return 0;
+    }
+
+    times[PHASE_PREPARE] = get_time_ns();
+    ALLOC_PHASE_BEGIN();
+    PERF_PHASE_BEGIN();
+    int is_valid = solver->prepare == NULL || solver->prepare(state);
+    PERF_PHASE_END(PHASE_PREPARE);
+    ALLOC_PHASE_END(PHASE_PREPARE);
+    if (!is_valid) {
+        solver->release(state);
+        return 0;
+    }
+
+    times[PHASE_SOLVE] = get_time_ns();
+    ALLOC_PHASE_BEGIN();
+    PERF_PHASE_BEGIN();
+    is_valid = solver->solve(state, answers);
+    PERF_PHASE_END(PHASE_SOLVE);
+    ALLOC_PHASE_END(PHASE_SOLVE);
+    times[PHASE_COUNT] = get_time_ns();
+    solver->release(state);
+
+    for (size_t phase = 0; phase < PHASE_COUNT && phase_ns != NULL; ++phase) {
+        phase_ns[phase] = times[phase + 1] - times[phase];
+    }
+    return is_valid;
+}
+
+// Runs all phases of the solver and exits if it rejected the input, the solver has reported the reason already
+static void run_solver_or_panic(const Solver* solver, const char* input, size_t input_size, SolverAnswers* answers,
+                                uint64_t* phase_ns) {
+    if (!run_solver(solver, input, input_size, answers, phase_ns)) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Looks the answers up in the result cache if $AOC_CACHE_DIR is set, key receives the key to store them under otherwise
+static int lookup_cached_answers(const Solver* solver, const char* input, size_t input_size, CacheKey* key,
+                                 SolverAnswers* answers) {
+    if (get_cache_dir() == NULL) {
+        return 0;
+    }
+
+    init_cache_key(key, solver->name, solver->version, input, input_size);
+    memset(answers, 0, sizeof(SolverAnswers));
+    return lookup_cache(key, &answers->part_1, &answers->part_2, &answers->has_part_2);
+}
+
+static void store_cached_answers(const CacheKey* key, const SolverAnswers* answers) {
+    if (get_cache_dir() != NULL) {
+        store_cache(key, answers->part_1, answers->part_2, answers->has_part_2);
+    }
+}
+
+static inline void print_answers(const SolverAnswers* answers) {
+    printf("Part 1: %llu\n", (unsigned long long)answers->part_1);
+    if (answers->has_part_2) {
+        printf("Part 2: %llu\n", (unsigned long long)answers->part_2);
+    }
+}
+
+// Writes the text as a quoted JSON string, filenames may contain quotes, backslashes and control characters
+static void write_json_string(FILE* output, const char* text) {
+    fputc('"', output);
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', output);
+            fputc(*c, output);
+        } else if (*c < 0x20) {
+            fprintf(output, "\\u%04x", *c);
+        } else {
+            fputc(*c, output);
+        }
+    }
+    fputc('"', output);
+}
+
+#ifdef AOC_BENCH
+static int compare_u64(const void* lhs, const void* rhs) {
+    uint64_t a = *(const uint64_t*)lhs;
+    uint64_t b = *(const uint64_t*)rhs;
+    return (a > b) - (a < b);
+}
+
+static void write_phase_statistics(FILE* output, const char* name, uint64_t* samples, size_t count) {
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+    size_t p99_index = (count * 99 + 99) / 100 - 1;  // Nearest rank
+
+    fprintf(output,
+            "\"%s\": {\"min_ns\": %llu, \"median_ns\": %llu, \"mean_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+            name, (unsigned long long)samples[0], (unsigned long long)samples[count / 2],
+            (unsigned long long)(sum / count), (unsigned long long)samples[p99_index],
+            (unsigned long long)samples[count - 1]);
+}
+
+// Runs the solver repeatedly on the in memory input and writes one JSON object with the statistics per phase
+static void run_benchmark(FILE* output, const Solver* solver, const char* input_name, const char* input,
+                          size_t input_size, size_t repetitions, size_t warmup) {
+    SolverAnswers answers;
+    for (size_t i = 0; i < warmup; ++i) {
+        run_solver_or_panic(solver, input, input_size, &answers, NULL);
+    }
+    PERF_RESET();  // Only count the measured repetitions
+    ALLOC_RESET();
+
+    uint64_t* samples = (uint64_t*)malloc((PHASE_COUNT + 1) * repetitions * sizeof(uint64_t));
+    if (samples == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed for %zu benchmark samples\n", repetitions);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < repetitions; ++i) {
+        uint64_t phase_ns[PHASE_COUNT];
+        run_solver_or_panic(solver, input, input_size, &answers, phase_ns);
+
+        uint64_t total = 0;
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+            samples[phase * repetitions + i] = phase_ns[phase];
+            total += phase_ns[phase];
+        }
+        samples[PHASE_COUNT * repetitions + i] = total;
+    }
+
+    fprintf(output, "{\"solver\": \"%s\", \"input\": ", solver->name);
+    write_json_string(output, input_name);
+    fprintf(output, ", \"input_bytes\": %zu, ", input_size);
+    fprintf(output, "\"repetitions\": %zu, \"warmup\": %zu, \"phases\": {", repetitions, warmup);
+    for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+        write_phase_statistics(output, SOLVER_PHASE_NAMES[phase], &samples[phase * repetitions], repetitions);
+        fprintf(output, ", ");
+    }
+    write_phase_statistics(output, "total", &samples[PHASE_COUNT * repetitions], repetitions);
+    fprintf(output, "}, ");
+#ifdef AOC_PERF
+    fprintf(output, "\"counters\": ");
+    PERF_WRITE_JSON(output, SOLVER_PHASE_NAMES, PHASE_COUNT);
+    fprintf(output, ", ");
+#endif
+#if defined(AOC_ALLOC_STATS) && defined(__cplusplus)
+    fprintf(output, "\"allocations\": ");
+    ALLOC_WRITE_JSON(output, SOLVER_PHASE_NAMES, PHASE_COUNT);
+    fprintf(output, ", ");
+#endif
+    fprintf(output, "\"part_1\": %llu", (unsigned long long)answers.part_1);
+    if (answers.has_part_2) {
+        fprintf(output, ", \"part_2\": %llu", (unsigned long long)answers.part_2);
+    }
+    fprintf(output, "}\n");
+
+    free(samples);
+}
+#endif
+
+static size_t parse_count_or_panic(const char* text, const char* name) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*text == '\0' || *end != '\0') {
+        fprintf(stderr, "Invalid %s '%s'\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    return (size_t)value;
+}
+
+typedef struct BatchEntry {
+    const char* filename;
+    SolverAnswers answers;
+    int is_readable;
+    int is_valid;
+    int is_cached;
+    int is_done;
+} BatchEntry;
+
+typedef struct Batch {
+    const Solver* solver;
+    BatchEntry* entries;
+    size_t count;
+    size_t next_entry;
+    size_t thread_budget;  // Threads of the parallel loops in one worker
+    pthread_mutex_t lock;
+    pthread_cond_t entry_done;
+} Batch;
+
+// Reads the file into the buffer of the worker, which only grows, returns 0 if the file can not be read
+static int read_file_into(const char* filename, char** buffer, size_t* capacity, size_t* size) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < 0) {
+        fclose(file);
+        return 0;
+    }
+
+    *size = (size_t)length;
+    if (*size + 1 > *capacity) {
+        free(*buffer);
+        *capacity = *size + 1 > 2 * *capacity ? *size + 1 : 2 * *capacity;
+        *buffer = (char*)malloc(*capacity);
+        if (*buffer == NULL) {
+            fprintf(stderr, "Unable to aquire memory needed to read '%s'\n", filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    *size = fread(*buffer, sizeof(char), *size, file);
+    (*buffer)[*size] = '\0';
+    fclose(file);
+    return 1;
+}
+
+// Worker of the batch pool. Each worker keeps its input buffer (and the thread local scratch memory of the C++
+// solvers) for all entries it takes, the state of the solver is parsed and released per entry. Entries are handed out
+// in manifest order.
+static void* run_batch_worker(void* context) {
+    Batch* batch = (Batch*)context;
+    char* input = NULL;
+    size_t capacity = 0;
+#ifdef __cplusplus
+    set_thread_budget(batch->thread_budget);
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        size_t index = batch->next_entry++;
+        pthread_mutex_unlock(&batch->lock);
+        if (index >= batch->count) {
+            break;
+        }
+
+        BatchEntry* entry = &batch->entries[index];
+        size_t input_size;
+        entry->is_readable = read_file_into(entry->filename, &input, &capacity, &input_size);
+        CacheKey key;
+        if (entry->is_readable) {
+            entry->is_cached = lookup_cached_answers(batch->solver, input, input_size, &key, &entry->answers);
+        }
+        entry->is_valid = entry->is_readable;
+        if (entry->is_readable && !entry->is_cached) {
+            const Solver* solver = batch->solver;
+            void* state = solver->parse(input, input_size);
+            entry->is_valid = state != NULL && (solver->prepare == NULL || solver->prepare(state)) &&
+                              solver->solve(state, &entry->answers);
+            if (state != NULL) {
+                solver->release(state);
+            }
+            if (entry->is_valid) {
+                store_cached_answers(&key, &entry->answers);
+            }
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        entry->is_done = 1;
+        pthread_cond_broadcast(&batch->entry_done);
+        pthread_mutex_unlock(&batch->lock);
+    }
+
+    free(input);
+    return NULL;
+}
+
+static void write_batch_entry(FILE* output, const Solver* solver, const BatchEntry* entry) {
+    fprintf(output, "{\"solver\": \"%s\", \"input\": ", solver->name);
+    write_json_string(output, entry->filename);
+    fprintf(output, ", ");
+    if (!entry->is_readable) {
+        fprintf(output, "\"error\": \"unreadable input\"}\n");
+        return;
+    }
+    if (!entry->is_valid) {
+        fprintf(output, "\"error\": \"invalid input\"}\n");
+        return;
+    }
+
+    fprintf(output, "\"part_1\": %llu", (unsigned long long)entry->answers.part_1);
+    if (entry->answers.has_part_2) {
+        fprintf(output, ", \"part_2\": %llu", (unsigned long long)entry->answers.part_2);
+    }
+    fprintf(output, ", \"cached\": %s}\n", entry->is_cached ? "true" : "false");
+}
+
+// Solves every input file listed in the manifest (one filename per line, empty lines are skipped) on a pool of
+// threads and writes one JSON line per input in manifest order as soon as the input and all before it are done.
+// Unreadable and invalid inputs are reported in their line and do not stop the batch.
+static void run_batch(FILE* output, const Solver* solver, const char* manifest_filename, size_t thread_count) {
+    size_t manifest_size;
+    char* manifest = read_file_or_panic(manifest_filename, &manifest_size);
+
+    size_t line_count = 1;
+    for (size_t i = 0; i < manifest_size; ++i) {
+        line_count += manifest[i] == '\n';
+    }
+
+    Batch batch = {solver, NULL, 0, 0, 1, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    batch.entries = (BatchEntry*)calloc(line_count, sizeof(BatchEntry));
+    if (batch.entries == NULL) {
+        fprintf(stderr, "Unable to aquire memory needed for %zu batch entries\n", line_count);
+        exit(EXIT_FAILURE);
+    }
+
+    char* line = manifest;
+    while (line < manifest + manifest_size) {
+        char* line_end = strchr(line, '\n');
+        if (line_end == NULL) {
+            line_end = manifest + manifest_size;
+        }
+        *line_end = '\0';
+        if (line_end > line) {
+            batch.entries[batch.count++].filename = line;
+        }
+        line = line_end + 1;
+    }
+
+    if (thread_count > batch.count) {
+        thread_count = batch.count;
+    }
+    // The workers share the CPUs with each other, so the parallel loops of the solvers split what is left over
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count > 0 && online_cpus > (long)thread_count) {
+        batch.thread_budget = (size_t)online_cpus / thread_count;
+    }
+    pthread_t threads[MAX_BATCH_THREADS];
+    for (size_t i = 0; i < thread_count; ++i) {
+        if (pthread_create(&threads[i], NULL, run_batch_worker, &batch) != 0) {
+            fprintf(stderr, "Unable to start batch worker %zu\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t i = 0; i < batch.count; ++i) {
+        pthread_mutex_lock(&batch.lock);
+        while (!batch.entries[i].is_done) {
+            pthread_cond_wait(&batch.entry_done, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        write_batch_entry(output, solver, &batch.entries[i]);
+        fflush(output);
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.entry_done);
+    free(batch.entries);
+    free(manifest);
+}
+
+static int is_batch_invocation(int argc, const char** argv) { return argc > 1 && strcmp(argv[1], BATCH_FLAG) == 0; }
+
+// Default main of a solver. Compiled with AOC_BENCH it benchmarks the solver instead:
+// <DATA FILENAME> [REPETITIONS] [WARMUP]
+// Compiled with AOC_PERF the hardware counters of every phase are reported as well,
+// AOC_ALLOC_STATS adds the heap allocations of every phase for the C++ solvers.
+// Outside of benchmarks the answers are served from the result cache when $AOC_CACHE_DIR is set (see cache.h).
+// In every build --batch <MANIFEST> [THREADS] solves all inputs of the manifest on a thread pool instead, the
+// counters are not collected in this mode.
+static int solver_main(int argc, const char** argv, const Solver* solver) {
+    if (is_batch_invocation(argc, argv)) {
+        if (argc < 3 || argc > 4) {
+            fprintf(stderr, "Invalid usage\n%s %s <MANIFEST FILENAME> [THREADS]\n", argv[0], BATCH_FLAG);
+            exit(EXIT_FAILURE);
+        }
+
+        long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (online_cpus < 1) {
+            online_cpus = 1;
+        } else if (online_cpus > MAX_BATCH_THREADS) {
+            online_cpus = MAX_BATCH_THREADS;
+        }
+        size_t thread_count = argc > 3 ? parse_count_or_panic(argv[3], "thread count") : (size_t)online_cpus;
+        if (thread_count == 0 || thread_count > MAX_BATCH_THREADS) {
+            fprintf(stderr, "The thread count has to be between 1 and %d\n", MAX_BATCH_THREADS);
+            exit(EXIT_FAILURE);
+        }
+
+        run_batch(stdout, solver, argv[2], thread_count);
+        return EXIT_SUCCESS;
+    }
+
+#ifdef AOC_BENCH
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Invalid usage\n%s <DATA FILENAME> [REPETITIONS] [WARMUP]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t repetitions = argc > 2 ? parse_count_or_panic(argv[2], "repetitions") : DEFAULT_BENCH_REPETITIONS;
+    size_t warmup = argc > 3 ? parse_count_or_panic(argv[3], "warmup") : DEFAULT_BENCH_WARMUP;
+    if (repetitions == 0) {
+        fprintf(stderr, "At least one repetition is needed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t input_size;
+    char* input = read_file_or_panic(argv[1], &input_size);
+    run_benchmark(stdout, solver, argv[1], input, input_size, repetitions, warmup);
+    free(input);
+#else
+    FILE* file = open_input_file_or_panic(argc, argv);
+    size_t input_size;
+    char* input = read_content(file, &input_size);
+    fclose(file);
+
+    SolverAnswers answers;
+    CacheKey key;
+    if (!lookup_cached_answers(solver, input, input_size, &key, &answers)) {
+        run_solver_or_panic(solver, input, input_size, &answers, NULL);
+        store_cached_answers(&key, &answers);
+    }
+    print_answers(&answers);
+    PERF_REPORT(stderr, SOLVER_PHASE_NAMES, PHASE_COUNT);
+    ALLOC_REPORT(stderr, SOLVER_PHASE_NAMES, PHASE_COUNT);
+    free(input);
+#endif
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+// Optional work counters and Chrome trace events for the C++ solvers.
+// TRACE_SCOPE records the wall time of the enclosing block as a complete event. TRACE_ADD and TRACE_MAX
+// attach counters to the innermost open scope, they are folded into the parent scope when it ends and
+// into the global totals at the top. Built with AOC_TRACE the events are written to $AOC_TRACE_FILE
+// (default trace.json) at exit, which chrome://tracing and Perfetto can load.
+// Without AOC_TRACE all macros expand to nothing.
+
+#ifdef AOC_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+struct Counter {
+    const char* key;
+    std::uint64_t value;
+    bool is_max;
+};
+
+struct Event {
+    const char* name;
+    std::uint64_t thread;
+    std::uint64_t start_ns, duration_ns;
+    std::vector<Counter> counters;
+};
+
+inline void merge_counter(std::vector<Counter>& counters, const char* key, std::uint64_t value, bool is_max) {
+    for (auto& counter : counters) {
+        if (std::strcmp(counter.key, key) == 0) {
+            counter.value = is_max ? std::max(counter.value, value) : counter.value + value;
+            return;
+        }
+    }
+    counters.push_back({key, value, is_max});
+}
+
+class Tracer {
+   public:
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::vector<Counter> totals;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    static Tracer& get() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    std::uint64_t now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin)
+            .count();
+    }
+
+    ~Tracer() {
+        const char* filename = std::getenv("AOC_TRACE_FILE");
+        FILE* file = std::fopen(filename != nullptr ? filename : "trace.json", "w");
+        if (file == nullptr) {
+            return;
+        }
+
+        std::fprintf(file, "{\"traceEvents\": [\n");
+        std::uint64_t end_ns = 0;
+        for (const auto& event : events) {
+            std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %llu, \"ts\": %.3f, \"dur\": %.3f",
+                         event.name, (unsigned long long)event.thread, event.start_ns / 1000.0,
+                         event.duration_ns / 1000.0);
+            for (std::size_t i = 0; i < event.counters.size(); ++i) {
+                std::fprintf(file, "%s\"%s\": %llu", i == 0 ? ", \"args\": {" : ", ", event.counters[i].key,
+                             (unsigned long long)event.counters[i].value);
+            }
+            std::fprintf(file, "%s},\n", event.counters.empty() ? "" : "}");
+            end_ns = std::max(end_ns, event.start_ns + event.duration_ns);
+        }
+
+        // Totals over the whole run as counter events at the end of the timeline
+        for (const auto& counter : totals) {
+            std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, \"args\": {\"%s\": %llu}},\n",
+                         counter.key, end_ns / 1000.0, counter.is_max ? "max" : "total",
+                         (unsigned long long)counter.value);
+        }
+        std::fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"aoc\"}}\n");
+        std::fprintf(file, "]}\n");
+        std::fclose(file);
+    }
+};
+
+inline std::uint64_t get_thread_id() {
+    static std::atomic<std::uint64_t> next_id{1};
+    thread_local std::uint64_t id = next_id++;
+    return id;
+}
+
+class Scope;
+inline thread_local Scope* innermost_scope = nullptr;
+
+class Scope {
+   public:
+    explicit Scope(const char* name) : parent(innermost_scope) {
+        event.name = name;
+        event.thread = get_thread_id();
+        event.start_ns = Tracer::get().now_ns();
+        innermost_scope = this;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope() {
+        auto& tracer = Tracer::get();
+        event.duration_ns = tracer.now_ns() - event.start_ns;
+        innermost_scope = parent;
+
+        if (parent != nullptr) {
+            for (const auto& counter : event.counters) {
+                merge_counter(parent->event.counters, counter.key, counter.value, counter.is_max);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(tracer.mutex);
+        if (parent == nullptr) {
+            for (const auto& counter : event.counters) {
+                merge_counter(tracer.totals, counter.key, counter.value, counter.is_max);
+            }
+        }
+        tracer.events.push_back(std::move(event));
+    }
+
+    Event event;
+    Scope* parent;
+};
+
+inline void record(const char* key, std::uint64_t value, bool is_max) {
+    if (innermost_scope != nullptr) {
+        merge_counter(innermost_scope->event.counters, key, value, is_max);
+        return;
+    }
+
+    auto& tracer = Tracer::get();
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    merge_counter(tracer.totals, key, value, is_max);
+}
+
+}  // namespace trace
+
+#define TRACE_CONCAT_(lhs, rhs) lhs##rhs
+#define TRACE_CONCAT(lhs, rhs) TRACE_CONCAT_(lhs, rhs)
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_ADD(key, value) trace::record(key, value, false)
+#define TRACE_MAX(key, value) trace::record(key, value, true)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_ADD(key, value)
+#define TRACE_MAX(key, value)
+
+#endif
+
+#endif